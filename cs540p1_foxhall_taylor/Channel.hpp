@@ -0,0 +1,344 @@
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+/* Needs -std=c++20 for the coroutines */
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "Deque.hpp"
+
+namespace cs540 {
+  class Executor;
+
+  // Fire and forget coroutine, hand it to Executor::spawn to get it going
+  class Task {
+  public:
+    struct promise_type {
+      Executor *executor = nullptr;
+
+      Task get_return_object() {
+        return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept;
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    Task(Task&& other): _h(other._h) { other._h = nullptr; }
+    ~Task() {
+      // Never got spawned
+      if (_h) _h.destroy();
+    }
+
+  private:
+    friend class Executor;
+    explicit Task(std::coroutine_handle<promise_type> h): _h(h) {}
+    std::coroutine_handle<promise_type> _h;
+  };
+
+  class Executor {
+  public:
+    virtual ~Executor() = default;
+    virtual void schedule(std::coroutine_handle<>) = 0;
+
+    void spawn(Task t) {
+      auto h = t._h;
+      t._h = nullptr;
+      h.promise().executor = this;
+      _task_started();
+      schedule(h);
+    }
+
+  protected:
+    friend struct Task::promise_type;
+    virtual void _task_started() {}
+    virtual void _task_done() {}
+  };
+
+  inline std::suspend_never Task::promise_type::final_suspend() noexcept {
+    executor->_task_done();
+    return {};
+  }
+
+  // Runs everything on the calling thread, run() returns once nothing is runnable
+  class LoopExecutor: public Executor {
+  public:
+    void schedule(std::coroutine_handle<> h) override {
+      _ready.push_back(h);
+    }
+
+    void run() {
+      while (!_ready.empty()) {
+        auto h = _ready.front();
+        _ready.pop_front();
+        h.resume();
+      }
+    }
+
+  private:
+    std::deque<std::coroutine_handle<>> _ready;
+  };
+
+  // Fixed pool of threads sharing one run queue, join() waits on every spawned task
+  class ThreadPoolExecutor: public Executor {
+  public:
+    explicit ThreadPoolExecutor(unsigned nthreads): _live(0), _stop(false) {
+      for (unsigned i = 0; i < nthreads; i++) {
+        _threads.emplace_back([this] { _work(); });
+      }
+    }
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+    ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+    ~ThreadPoolExecutor() {
+      join();
+    }
+
+    void schedule(std::coroutine_handle<> h) override {
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        _ready.push_back(h);
+      }
+      _cv.notify_one();
+    }
+
+    void join() {
+      {
+        std::unique_lock<std::mutex> g(_lock);
+        _idle.wait(g, [this] { return _live == 0; });
+        _stop = true;
+      }
+      _cv.notify_all();
+      for (auto& t: _threads) {
+        if (t.joinable()) t.join();
+      }
+    }
+
+  protected:
+    void _task_started() override {
+      std::lock_guard<std::mutex> g(_lock);
+      _live++;
+    }
+    void _task_done() override {
+      std::lock_guard<std::mutex> g(_lock);
+      if (--_live == 0) {
+        _idle.notify_all();
+      }
+    }
+
+  private:
+    void _work() {
+      for (;;) {
+        std::coroutine_handle<> h;
+        {
+          std::unique_lock<std::mutex> g(_lock);
+          _cv.wait(g, [this] { return _stop || !_ready.empty(); });
+          if (_ready.empty()) return;
+          h = _ready.front();
+          _ready.pop_front();
+        }
+        h.resume();
+      }
+    }
+
+    std::mutex _lock;
+    std::condition_variable _cv;
+    std::condition_variable _idle;
+    std::deque<std::coroutine_handle<>> _ready;
+    std::vector<std::thread> _threads;
+    size_t _live;
+    bool _stop;
+  };
+}
+
+/* Bounded channel whose buffer is a Deque_##_type, so Deque_DEFINE(_type) */
+/* has to come first. Waiters are linked through their awaiters, which live */
+/* in the suspended coroutine frames, so blocking never allocates. */
+#define Channel_DEFINE(_type)                                           \
+                                                                        \
+  class Channel_##_type {                                               \
+  public:                                                               \
+    /* capacity 0 makes every push wait for a matching pop */           \
+    explicit Channel_##_type(unsigned int capacity):                    \
+      _capacity(capacity), _closed(false),                              \
+      _pushers(nullptr), _pushers_tail(nullptr),                        \
+      _poppers(nullptr), _poppers_tail(nullptr) {                       \
+      /* The ring is never compared, so no comparison fn */            \
+      Deque_##_type##_ctor(&_ring, nullptr);                            \
+    }                                                                   \
+    Channel_##_type(const Channel_##_type&) = delete;                   \
+    Channel_##_type& operator=(const Channel_##_type&) = delete;        \
+    ~Channel_##_type() {                                                \
+      _ring.dtor(&_ring);                                               \
+    }                                                                   \
+                                                                        \
+    class PushAwaiter;                                                  \
+    class PopAwaiter;                                                   \
+                                                                        \
+    /* co_await push(x) is false once the channel is closed */          \
+    PushAwaiter push(_type elem) { return PushAwaiter(this, elem); }    \
+    /* co_await pop() is empty once closed and drained */               \
+    PopAwaiter pop() { return PopAwaiter(this); }                       \
+                                                                        \
+    void close() {                                                      \
+      PushAwaiter *pushers;                                             \
+      PopAwaiter *poppers;                                              \
+      {                                                                 \
+        std::lock_guard<std::mutex> g(_lock);                           \
+        _closed = true;                                                 \
+        pushers = _pushers;                                             \
+        poppers = _poppers;                                             \
+        _pushers = _pushers_tail = nullptr;                             \
+        _poppers = _poppers_tail = nullptr;                             \
+      }                                                                 \
+      while (pushers) {                                                 \
+        PushAwaiter *next = pushers->_next;                             \
+        pushers->_ok = false;                                           \
+        pushers->_wake();                                               \
+        pushers = next;                                                 \
+      }                                                                 \
+      while (poppers) {                                                 \
+        PopAwaiter *next = poppers->_next;                              \
+        poppers->_wake();                                               \
+        poppers = next;                                                 \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    unsigned int size() {                                               \
+      std::lock_guard<std::mutex> g(_lock);                             \
+      return _ring.size(&_ring);                                        \
+    }                                                                   \
+                                                                        \
+    class PushAwaiter {                                                 \
+    public:                                                             \
+      bool await_ready() const noexcept { return false; }               \
+      bool await_suspend(std::coroutine_handle<cs540::Task::promise_type> h) { \
+        _h = h;                                                         \
+        _executor = h.promise().executor;                               \
+        PopAwaiter *woken = nullptr;                                    \
+        {                                                               \
+          std::lock_guard<std::mutex> g(_chan->_lock);                  \
+          if (_chan->_closed) {                                         \
+            _ok = false;                                                \
+            return false;                                               \
+          }                                                             \
+          if (_chan->_poppers) {                                        \
+            /* Someone's already waiting, hand it over directly */     \
+            woken = _chan->_poppers;                                    \
+            _chan->_poppers = woken->_next;                             \
+            if (!_chan->_poppers) _chan->_poppers_tail = nullptr;       \
+            woken->_elem = _elem;                                       \
+          }                                                             \
+          else if ((unsigned int) _chan->_ring.size(&_chan->_ring) < _chan->_capacity) { \
+            _chan->_ring.push_back(&_chan->_ring, _elem);               \
+            return false;                                               \
+          }                                                             \
+          else {                                                        \
+            /* Full, get in line. Don't touch this after unlocking */   \
+            _next = nullptr;                                            \
+            if (_chan->_pushers_tail) _chan->_pushers_tail->_next = this; \
+            else _chan->_pushers = this;                                \
+            _chan->_pushers_tail = this;                                \
+            return true;                                                \
+          }                                                             \
+        }                                                               \
+        woken->_wake();                                                 \
+        return false;                                                   \
+      }                                                                 \
+      bool await_resume() const noexcept { return _ok; }                \
+                                                                        \
+    private:                                                            \
+      friend class Channel_##_type;                                     \
+      PushAwaiter(Channel_##_type *chan, const _type &elem):            \
+        _chan(chan), _elem(elem), _ok(true), _next(nullptr) {}          \
+      void _wake() { _executor->schedule(_h); }                         \
+                                                                        \
+      Channel_##_type *_chan;                                           \
+      _type _elem;                                                      \
+      bool _ok;                                                         \
+      PushAwaiter *_next;                                               \
+      std::coroutine_handle<> _h;                                       \
+      cs540::Executor *_executor;                                       \
+    };                                                                  \
+                                                                        \
+    class PopAwaiter {                                                  \
+    public:                                                             \
+      bool await_ready() const noexcept { return false; }               \
+      bool await_suspend(std::coroutine_handle<cs540::Task::promise_type> h) { \
+        _h = h;                                                         \
+        _executor = h.promise().executor;                               \
+        PushAwaiter *woken = nullptr;                                   \
+        {                                                               \
+          std::lock_guard<std::mutex> g(_chan->_lock);                  \
+          Deque_##_type *ring = &_chan->_ring;                          \
+          if (!ring->empty(ring)) {                                     \
+            _elem = ring->front(ring);                                  \
+            ring->pop_front(ring);                                      \
+            /* A slot just opened up for the first waiting pusher */   \
+            woken = _chan->_take_pusher();                              \
+            if (woken) ring->push_back(ring, woken->_elem);             \
+          }                                                             \
+          else if ((woken = _chan->_take_pusher())) {                   \
+            /* Unbuffered, take it straight from the pusher */          \
+            _elem = woken->_elem;                                       \
+          }                                                             \
+          else if (_chan->_closed) {                                    \
+            return false;                                               \
+          }                                                             \
+          else {                                                        \
+            _next = nullptr;                                            \
+            if (_chan->_poppers_tail) _chan->_poppers_tail->_next = this; \
+            else _chan->_poppers = this;                                \
+            _chan->_poppers_tail = this;                                \
+            return true;                                                \
+          }                                                             \
+        }                                                               \
+        if (woken) woken->_wake();                                      \
+        return false;                                                   \
+      }                                                                 \
+      std::optional<_type> await_resume() { return std::move(_elem); }  \
+                                                                        \
+    private:                                                            \
+      friend class Channel_##_type;                                     \
+      explicit PopAwaiter(Channel_##_type *chan):                       \
+        _chan(chan), _next(nullptr) {}                                  \
+      void _wake() { _executor->schedule(_h); }                         \
+                                                                        \
+      Channel_##_type *_chan;                                           \
+      std::optional<_type> _elem;                                       \
+      PopAwaiter *_next;                                                \
+      std::coroutine_handle<> _h;                                       \
+      cs540::Executor *_executor;                                       \
+    };                                                                  \
+                                                                        \
+  private:                                                              \
+    /* Must hold _lock */                                               \
+    PushAwaiter *_take_pusher() {                                       \
+      PushAwaiter *p = _pushers;                                        \
+      if (p) {                                                          \
+        _pushers = p->_next;                                            \
+        if (!_pushers) _pushers_tail = nullptr;                         \
+      }                                                                 \
+      return p;                                                         \
+    }                                                                   \
+                                                                        \
+    std::mutex _lock;                                                   \
+    Deque_##_type _ring;                                                \
+    unsigned int _capacity;                                             \
+    bool _closed;                                                       \
+    PushAwaiter *_pushers;                                              \
+    PushAwaiter *_pushers_tail;                                         \
+    PopAwaiter *_poppers;                                               \
+    PopAwaiter *_poppers_tail;                                          \
+  };
+
+#endif /* _CHANNEL_H_ */
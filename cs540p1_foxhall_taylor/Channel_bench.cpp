@@ -0,0 +1,118 @@
+/*
+ * Compile with -std=c++20 -pthread.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <chrono>
+#include "Channel.hpp"
+
+Deque_DEFINE(long)
+Channel_DEFINE(long)
+
+using Clock = std::chrono::steady_clock;
+using Nanos = std::chrono::duration<double, std::nano>;
+
+/*
+ * Ping-pong: one value bounces between two coroutines, so every hop is a
+ * suspend on one side and a wake on the other.
+ */
+
+cs540::Task pinger(Channel_long &ping, Channel_long &pong, long rounds, long *out) {
+  long v = 0;
+  for (long i = 0; i < rounds; i++) {
+    co_await ping.push(v);
+    v = *co_await pong.pop();
+  }
+  ping.close();
+  *out = v;
+}
+
+cs540::Task ponger(Channel_long &ping, Channel_long &pong) {
+  while (auto v = co_await ping.pop()) {
+    co_await pong.push(*v + 1);
+  }
+}
+
+template <typename Run>
+void ping_pong(const char *name, cs540::Executor &ex, Run run, long rounds) {
+  Channel_long ping(1), pong(1);
+  long result = 0;
+
+  auto start = Clock::now();
+  ex.spawn(pinger(ping, pong, rounds, &result));
+  ex.spawn(ponger(ping, pong));
+  run();
+  Nanos elapsed = Clock::now() - start;
+
+  assert(result == rounds);
+  printf("ping-pong %-12s %ld round trips, %.1f ns per round trip\n",
+         name, rounds, elapsed.count() / rounds);
+}
+
+/*
+ * Fan-in: lots of producers, one consumer, one bounded channel.
+ */
+
+cs540::Task producer(Channel_long &ch, long first, long count, long *left) {
+  for (long i = first; i < first + count; i++) {
+    co_await ch.push(i);
+  }
+  // Last one out closes up
+  if (__atomic_sub_fetch(left, 1, __ATOMIC_ACQ_REL) == 0) {
+    ch.close();
+  }
+}
+
+cs540::Task consumer(Channel_long &ch, long *sum, long *count) {
+  while (auto v = co_await ch.pop()) {
+    *sum += *v;
+    (*count)++;
+  }
+}
+
+template <typename Run>
+void fan_in(const char *name, cs540::Executor &ex, Run run,
+            long producers, long per_producer, unsigned capacity) {
+  Channel_long ch(capacity);
+  long left = producers, sum = 0, count = 0;
+
+  auto start = Clock::now();
+  ex.spawn(consumer(ch, &sum, &count));
+  for (long p = 0; p < producers; p++) {
+    ex.spawn(producer(ch, p * per_producer, per_producer, &left));
+  }
+  run();
+  Nanos elapsed = Clock::now() - start;
+
+  long total = producers * per_producer;
+  assert(count == total);
+  assert(sum == total * (total - 1) / 2);
+  printf("fan-in    %-12s %ld producers, cap %u, %.2f M items/s\n",
+         name, producers, capacity, total / (elapsed.count() / 1e3));
+}
+
+int
+main() {
+  const long rounds = 1000000;
+
+  {
+    cs540::LoopExecutor loop;
+    ping_pong("loop", loop, [&] { loop.run(); }, rounds);
+  }
+  {
+    cs540::ThreadPoolExecutor pool(2);
+    ping_pong("pool(2)", pool, [&] { pool.join(); }, rounds / 10);
+  }
+
+  for (unsigned cap: {1u, 64u, 1024u}) {
+    {
+      cs540::LoopExecutor loop;
+      fan_in("loop", loop, [&] { loop.run(); }, 16, 200000, cap);
+    }
+    {
+      cs540::ThreadPoolExecutor pool(4);
+      fan_in("pool(4)", pool, [&] { pool.join(); }, 16, 50000, cap);
+    }
+  }
+}
@@ -2,6 +2,7 @@
 #define _DEQUE_H_
 
 #include <stdlib.h>
+#include <string.h>
 
 #define Deque_DEFINE(_type)                                             \
                                                                         \
@@ -20,6 +21,8 @@
     unsigned int _ring_head;                                            \
     unsigned int _ring_tail;                                            \
     _type##_ptr _ring;                                                  \
+    /* Backing file while mapped in append mode, see DequeFile.hpp */   \
+    int _fd = -1;                                                       \
                                                                         \
     bool (*_cmp)(const _type &, const _type &);                         \
                                                                         \
@@ -216,16 +219,24 @@
     return it;                                                          \
   }                                                                     \
                                                                         \
-  /* Constructor */                                                     \
+  /* Copy the live range into dst[0, size) with at most two memcpys */  \
+  void _copy_ring_##_type(_type##_ptr dst, const Deque_##_type *src) {  \
+    if (src->_size == 0) {                                              \
+      return;                                                           \
+    }                                                                   \
                                                                         \
-  void Deque_##_type##_ctor(Deque_##_type *deq, bool (*_cmp)(const _type &, const _type &)) { \
-    deq->_size = 0;                                                     \
-    deq->_cap = 11; /* default cap */                                   \
-    deq->_cmp = _cmp;                                                   \
-    deq->_ring_head = deq->_cap / 2;                                    \
-    deq->_ring_tail = deq->_cap / 2;                                    \
-    deq->_ring = (_type##_ptr) malloc(deq->_cap * sizeof(_type));       \
+    if (src->_ring_head <= src->_ring_tail) {                           \
+      memcpy(dst, src->_ring + src->_ring_head, src->_size * sizeof(_type)); \
+    }                                                                   \
+    else {                                                              \
+      /* Wrapped, so copy [head, cap) then [0, tail] */                 \
+      unsigned int first = src->_cap - src->_ring_head;                 \
+      memcpy(dst, src->_ring + src->_ring_head, first * sizeof(_type)); \
+      memcpy(dst + first, src->_ring, (src->_size - first) * sizeof(_type)); \
+    }                                                                   \
+  }                                                                     \
                                                                         \
+  void _bind_##_type(Deque_##_type *deq) {                              \
     deq->size = &_size_##_type;                                         \
     deq->empty = &_empty_##_type;                                       \
     deq->push_front = &_push_front_##_type;                             \
@@ -242,6 +253,79 @@
     deq->end = &_end_##_type;                                           \
   }                                                                     \
                                                                         \
+  /* Constructor */                                                     \
+                                                                        \
+  void Deque_##_type##_ctor(Deque_##_type *deq, bool (*_cmp)(const _type &, const _type &)) { \
+    deq->_size = 0;                                                     \
+    deq->_cap = 11; /* default cap */                                   \
+    deq->_cmp = _cmp;                                                   \
+    deq->_ring_head = deq->_cap / 2;                                    \
+    deq->_ring_tail = deq->_cap / 2;                                    \
+    deq->_ring = (_type##_ptr) malloc(deq->_cap * sizeof(_type));       \
+                                                                        \
+    _bind_##_type(deq);                                                 \
+  }                                                                     \
+                                                                        \
+  /* Copying */                                                         \
+                                                                        \
+  /* Construct deq as a copy of src with a single allocation. If */     \
+  /* linearize is set the copy is packed to start at index 0 with */    \
+  /* just enough room, otherwise it keeps src's capacity and layout */  \
+  void Deque_##_type##_clone(Deque_##_type *deq, const Deque_##_type *src, bool linearize) { \
+    deq->_size = src->_size;                                            \
+    deq->_cmp = src->_cmp;                                              \
+                                                                        \
+    if (linearize) {                                                    \
+      /* One spare slot so the ring never has to be empty at cap 0 */   \
+      deq->_cap = src->_size + 1;                                       \
+      deq->_ring_head = 0;                                              \
+      deq->_ring_tail = src->_size > 0 ? src->_size - 1 : 0;            \
+      deq->_ring = (_type##_ptr) malloc(deq->_cap * sizeof(_type));     \
+      _copy_ring_##_type(deq->_ring, src);                              \
+    }                                                                   \
+    else {                                                              \
+      deq->_cap = src->_cap;                                            \
+      deq->_ring_head = src->_ring_head;                                \
+      deq->_ring_tail = src->_ring_tail;                                \
+      deq->_ring = (_type##_ptr) malloc(deq->_cap * sizeof(_type));     \
+      /* Same slots as src, so at most two memcpys again */             \
+      if (src->_size > 0) {                                             \
+        if (src->_ring_head <= src->_ring_tail) {                       \
+          memcpy(deq->_ring + src->_ring_head, src->_ring + src->_ring_head, \
+                 src->_size * sizeof(_type));                           \
+        }                                                               \
+        else {                                                          \
+          memcpy(deq->_ring + src->_ring_head, src->_ring + src->_ring_head, \
+                 (src->_cap - src->_ring_head) * sizeof(_type));        \
+          memcpy(deq->_ring, src->_ring, (src->_ring_tail + 1) * sizeof(_type)); \
+        }                                                               \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    _bind_##_type(deq);                                                 \
+  }                                                                     \
+                                                                        \
+  /* Assignment, deq must already be constructed. Reuses deq's ring */  \
+  /* when it is big enough and always linearizes the copy */            \
+  void Deque_##_type##_assign(Deque_##_type *deq, const Deque_##_type *src) { \
+    if (deq == src) {                                                   \
+      return;                                                           \
+    }                                                                   \
+                                                                        \
+    if (deq->_cap < src->_size + 1) {                                   \
+      /* Nothing in the old ring is worth keeping so skip realloc's copy */ \
+      free(deq->_ring);                                                 \
+      deq->_cap = src->_size + 1;                                       \
+      deq->_ring = (_type##_ptr) malloc(deq->_cap * sizeof(_type));     \
+    }                                                                   \
+                                                                        \
+    _copy_ring_##_type(deq->_ring, src);                                \
+    deq->_size = src->_size;                                            \
+    deq->_cmp = src->_cmp;                                              \
+    deq->_ring_head = 0;                                                \
+    deq->_ring_tail = src->_size > 0 ? src->_size - 1 : 0;              \
+  }                                                                     \
+                                                                        \
   /* Comparison */                                                      \
                                                                         \
   bool Deque_##_type##_Iterator_equal(const Deque_##_type##_Iterator& it1, const Deque_##_type##_Iterator& it2) { \
@@ -0,0 +1,305 @@
+#ifndef _DEQUE_FILE_H_
+#define _DEQUE_FILE_H_
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <type_traits>
+
+#include "Deque.hpp"
+
+/* Open modes */
+#define DEQUE_FILE_READ   0 /* Private mapping, changes never hit the file */
+#define DEQUE_FILE_APPEND 1 /* Shared mapping, the file follows every push/pop */
+
+/* In append mode a push that needs the file to grow and can't get it */
+/* (disk full, file size limit) refuses the element, so the deque and */
+/* the file stay as they were and errno says why. push_back/push_front */
+/* can't say so, Deque_T_try_push_back/_front return false instead. */
+
+/* The file is this header followed by the ring itself, _cap slots long. */
+/* It's padded to 64 bytes so the ring stays aligned for anything sane. */
+typedef struct DequeFile_Header {
+  char magic[8];
+  uint32_t elem_size;
+  uint32_t cap;
+  uint32_t size;
+  uint32_t ring_head;
+  uint32_t ring_tail;
+  char _pad[36];
+} DequeFile_Header;
+
+static_assert(sizeof(DequeFile_Header) == 64, "DequeFile_Header must stay 64 bytes");
+
+static const char DEQUE_FILE_MAGIC[8] = "DEQUE01";
+
+/* Needs Deque_DEFINE(_type) to come first */
+#define DequeFile_DEFINE(_type)                                         \
+                                                                        \
+  static_assert(std::is_trivially_copyable<_type>::value,               \
+                "DequeFile_DEFINE needs a trivially copyable type");    \
+                                                                        \
+  /* The header sits right in front of a mapped ring */                 \
+  DequeFile_Header *_file_header_##_type(const Deque_##_type *deq) {    \
+    return ((DequeFile_Header *) deq->_ring) - 1;                       \
+  }                                                                     \
+                                                                        \
+  size_t _file_len_##_type(unsigned int cap) {                          \
+    return sizeof(DequeFile_Header) + (size_t) cap * sizeof(_type);     \
+  }                                                                     \
+                                                                        \
+  void _file_sync_##_type(Deque_##_type *deq) {                         \
+    DequeFile_Header *hdr = _file_header_##_type(deq);                  \
+    hdr->cap = deq->_cap;                                               \
+    hdr->size = deq->_size;                                             \
+    hdr->ring_head = deq->_ring_head;                                   \
+    hdr->ring_tail = deq->_ring_tail;                                   \
+  }                                                                     \
+                                                                        \
+  /* Append mode, every modifier writes its bookkeeping back */         \
+                                                                        \
+  /* Doubles the file and the mapping, nothing changes on failure */    \
+  bool _file_grow_##_type(Deque_##_type *deq) {                         \
+    DequeFile_Header *hdr = _file_header_##_type(deq);                  \
+    unsigned int old_cap = deq->_cap;                                   \
+    size_t old_len = _file_len_##_type(old_cap);                        \
+    size_t new_len = _file_len_##_type(old_cap * 2);                    \
+                                                                        \
+    if (ftruncate(deq->_fd, new_len) != 0) {                            \
+      return false;                                                     \
+    }                                                                   \
+    void *map = mremap(hdr, old_len, new_len, MREMAP_MAYMOVE);          \
+    /* Leaves the file too long, which open doesn't mind */            \
+    if (map == MAP_FAILED) {                                            \
+      return false;                                                     \
+    }                                                                   \
+                                                                        \
+    deq->_cap = old_cap * 2;                                            \
+    deq->_ring = (_type##_ptr) ((DequeFile_Header *) map + 1);          \
+                                                                        \
+    /* Same unwrapping as the heap version */                           \
+    if (deq->_ring_head > deq->_ring_tail) {                            \
+      memcpy(deq->_ring + old_cap, deq->_ring,                          \
+             (deq->_ring_tail + 1) * sizeof(_type));                    \
+      deq->_ring_tail += old_cap;                                       \
+    }                                                                   \
+    _file_sync_##_type(deq);                                            \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  void _file_expand_##_type(Deque_##_type *deq) {                       \
+    _file_grow_##_type(deq);                                            \
+  }                                                                     \
+                                                                        \
+  /* Grows ahead of the plain push so it never has to expand itself */ \
+                                                                        \
+  bool _file_push_front_##_type(Deque_##_type *deq, _type elem) {       \
+    if (deq->_size + 1 >= deq->_cap && !_file_grow_##_type(deq)) {      \
+      return false;                                                     \
+    }                                                                   \
+    _push_front_##_type(deq, elem);                                     \
+    _file_sync_##_type(deq);                                            \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  bool _file_push_back_##_type(Deque_##_type *deq, const _type elem) {  \
+    if (deq->_size + 1 >= deq->_cap && !_file_grow_##_type(deq)) {      \
+      return false;                                                     \
+    }                                                                   \
+    _push_back_##_type(deq, elem);                                      \
+    _file_sync_##_type(deq);                                            \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  void _file_push_front_void_##_type(Deque_##_type *deq, _type elem) {  \
+    _file_push_front_##_type(deq, elem);                                \
+  }                                                                     \
+                                                                        \
+  void _file_push_back_void_##_type(Deque_##_type *deq, const _type elem) { \
+    _file_push_back_##_type(deq, elem);                                 \
+  }                                                                     \
+                                                                        \
+  void _file_pop_front_##_type(Deque_##_type *deq) {                    \
+    _pop_front_##_type(deq);                                            \
+    _file_sync_##_type(deq);                                            \
+  }                                                                     \
+                                                                        \
+  void _file_pop_back_##_type(Deque_##_type *deq) {                     \
+    _pop_back_##_type(deq);                                             \
+    _file_sync_##_type(deq);                                            \
+  }                                                                     \
+                                                                        \
+  void _file_clear_##_type(Deque_##_type *deq) {                        \
+    _clear_##_type(deq);                                                \
+    _file_sync_##_type(deq);                                            \
+  }                                                                     \
+                                                                        \
+  void _file_dtor_##_type(Deque_##_type *deq) {                         \
+    munmap(_file_header_##_type(deq), _file_len_##_type(deq->_cap));    \
+    close(deq->_fd);                                                    \
+    deq->_fd = -1;                                                      \
+    deq->_ring = nullptr;                                               \
+  }                                                                     \
+                                                                        \
+  /* Read mode, the first expand moves the ring onto the heap */        \
+                                                                        \
+  void _file_ro_expand_##_type(Deque_##_type *deq) {                    \
+    DequeFile_Header *hdr = _file_header_##_type(deq);                  \
+    _type##_ptr ring = (_type##_ptr) malloc(deq->_cap * sizeof(_type)); \
+    memcpy(ring, deq->_ring, deq->_cap * sizeof(_type));                \
+    munmap(hdr, _file_len_##_type(deq->_cap));                          \
+                                                                        \
+    /* From here on it's just a regular deque */                        \
+    deq->_ring = ring;                                                  \
+    _bind_##_type(deq);                                                 \
+    deq->expand(deq);                                                   \
+  }                                                                     \
+                                                                        \
+  void _file_ro_dtor_##_type(Deque_##_type *deq) {                      \
+    munmap(_file_header_##_type(deq), _file_len_##_type(deq->_cap));    \
+    deq->_ring = nullptr;                                               \
+  }                                                                     \
+                                                                        \
+  /* Write deq to path, packed so the ring starts at slot 0 */          \
+  bool Deque_##_type##_save(const Deque_##_type *deq, const char *path) { \
+    DequeFile_Header hdr;                                               \
+    memset(&hdr, 0, sizeof hdr);                                        \
+    memcpy(hdr.magic, DEQUE_FILE_MAGIC, sizeof hdr.magic);              \
+    hdr.elem_size = sizeof(_type);                                      \
+    hdr.cap = deq->_size + 1;                                           \
+    hdr.size = deq->_size;                                              \
+    hdr.ring_head = 0;                                                  \
+    hdr.ring_tail = deq->_size > 0 ? deq->_size - 1 : 0;                \
+                                                                        \
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);              \
+    if (fd < 0) {                                                       \
+      return false;                                                     \
+    }                                                                   \
+    /* Size the file up front, the spare slot is left as a hole */      \
+    if (ftruncate(fd, _file_len_##_type(hdr.cap)) != 0) {               \
+      close(fd);                                                        \
+      return false;                                                     \
+    }                                                                   \
+    void *map = mmap(nullptr, _file_len_##_type(hdr.cap),               \
+                     PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);        \
+    close(fd);                                                          \
+    if (map == MAP_FAILED) {                                            \
+      return false;                                                     \
+    }                                                                   \
+                                                                        \
+    memcpy(map, &hdr, sizeof hdr);                                      \
+    _copy_ring_##_type((_type##_ptr) ((DequeFile_Header *) map + 1), deq); \
+    bool ok = msync(map, _file_len_##_type(hdr.cap), MS_SYNC) == 0;     \
+    munmap(map, _file_len_##_type(hdr.cap));                            \
+    return ok;                                                          \
+  }                                                                     \
+                                                                        \
+  /* Construct deq straight out of the file at path, nothing is */      \
+  /* deserialized. In append mode a missing file is created. */         \
+  bool Deque_##_type##_open(Deque_##_type *deq, const char *path,       \
+                            bool (*_cmp)(const _type &, const _type &), int mode) { \
+    bool append = mode == DEQUE_FILE_APPEND;                            \
+    int fd = open(path, append ? O_RDWR | O_CREAT : O_RDONLY, 0644);    \
+    if (fd < 0) {                                                       \
+      return false;                                                     \
+    }                                                                   \
+                                                                        \
+    struct stat st;                                                     \
+    if (fstat(fd, &st) != 0) {                                          \
+      close(fd);                                                        \
+      return false;                                                     \
+    }                                                                   \
+                                                                        \
+    if (st.st_size == 0 && append) {                                    \
+      /* Brand new file, lay out an empty deque with the default cap */ \
+      DequeFile_Header hdr;                                             \
+      memset(&hdr, 0, sizeof hdr);                                      \
+      memcpy(hdr.magic, DEQUE_FILE_MAGIC, sizeof hdr.magic);            \
+      hdr.elem_size = sizeof(_type);                                    \
+      hdr.cap = 11;                                                     \
+      hdr.ring_head = hdr.cap / 2;                                      \
+      hdr.ring_tail = hdr.cap / 2;                                      \
+      if (ftruncate(fd, _file_len_##_type(hdr.cap)) != 0 ||             \
+          pwrite(fd, &hdr, sizeof hdr, 0) != (ssize_t) sizeof hdr) {    \
+        close(fd);                                                      \
+        return false;                                                   \
+      }                                                                 \
+      st.st_size = _file_len_##_type(hdr.cap);                          \
+    }                                                                   \
+                                                                        \
+    DequeFile_Header hdr;                                               \
+    if ((size_t) st.st_size < sizeof hdr ||                             \
+        pread(fd, &hdr, sizeof hdr, 0) != (ssize_t) sizeof hdr ||       \
+        memcmp(hdr.magic, DEQUE_FILE_MAGIC, sizeof hdr.magic) != 0 ||   \
+        hdr.elem_size != sizeof(_type) ||                               \
+        hdr.cap == 0 || hdr.size >= hdr.cap ||                          \
+        hdr.ring_head >= hdr.cap || hdr.ring_tail >= hdr.cap ||         \
+        (size_t) st.st_size < _file_len_##_type(hdr.cap)) {             \
+      close(fd);                                                        \
+      return false;                                                     \
+    }                                                                   \
+                                                                        \
+    /* Private mappings are copy on write so read mode can still */     \
+    /* poke at elements without touching the file */                    \
+    void *map = mmap(nullptr, _file_len_##_type(hdr.cap),               \
+                     PROT_READ | PROT_WRITE,                            \
+                     append ? MAP_SHARED : MAP_PRIVATE, fd, 0);         \
+    if (map == MAP_FAILED) {                                            \
+      close(fd);                                                        \
+      return false;                                                     \
+    }                                                                   \
+                                                                        \
+    deq->_size = hdr.size;                                              \
+    deq->_cap = hdr.cap;                                                \
+    deq->_ring_head = hdr.ring_head;                                    \
+    deq->_ring_tail = hdr.ring_tail;                                    \
+    deq->_ring = (_type##_ptr) ((DequeFile_Header *) map + 1);          \
+    deq->_cmp = _cmp;                                                   \
+    _bind_##_type(deq);                                                 \
+                                                                        \
+    if (append) {                                                       \
+      deq->_fd = fd;                                                    \
+      deq->push_front = &_file_push_front_void_##_type;                 \
+      deq->push_back = &_file_push_back_void_##_type;                   \
+      deq->pop_front = &_file_pop_front_##_type;                        \
+      deq->pop_back = &_file_pop_back_##_type;                          \
+      deq->clear = &_file_clear_##_type;                                \
+      deq->expand = &_file_expand_##_type;                              \
+      deq->dtor = &_file_dtor_##_type;                                  \
+    }                                                                   \
+    else {                                                              \
+      close(fd);                                                        \
+      deq->expand = &_file_ro_expand_##_type;                           \
+      deq->dtor = &_file_ro_dtor_##_type;                               \
+    }                                                                   \
+                                                                        \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  /* Pushes that say whether the element made it in, only append */    \
+  /* mode can ever turn one away */                                     \
+  bool Deque_##_type##_try_push_back(Deque_##_type *deq, const _type elem) { \
+    if (deq->_fd < 0) {                                                 \
+      deq->push_back(deq, elem);                                        \
+      return true;                                                      \
+    }                                                                   \
+    return _file_push_back_##_type(deq, elem);                          \
+  }                                                                     \
+                                                                        \
+  bool Deque_##_type##_try_push_front(Deque_##_type *deq, _type elem) { \
+    if (deq->_fd < 0) {                                                 \
+      deq->push_front(deq, elem);                                       \
+      return true;                                                      \
+    }                                                                   \
+    return _file_push_front_##_type(deq, elem);                         \
+  }                                                                     \
+                                                                        \
+  /* Push an append mode deque's pages out to disk */                   \
+  bool Deque_##_type##_flush(Deque_##_type *deq) {                      \
+    return msync(_file_header_##_type(deq), _file_len_##_type(deq->_cap), MS_SYNC) == 0; \
+  }
+
+#endif /* _DEQUE_FILE_H_ */
@@ -0,0 +1,175 @@
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "DequeFile.hpp"
+
+struct Job {
+  int id;
+  double cost;
+};
+
+bool
+Job_less_by_id(const Job &o1, const Job &o2) {
+  return o1.id < o2.id;
+}
+
+Deque_DEFINE(Job)
+DequeFile_DEFINE(Job)
+
+int
+main() {
+  char path[] = "/tmp/deque_file_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  // Save a wrapped deque, then map it back in
+  {
+    Deque_Job deq;
+    Deque_Job_ctor(&deq, Job_less_by_id);
+    for (int i = 0; i < 20; i++) {
+      deq.push_back(&deq, Job{i, i * 0.5});
+    }
+    for (int i = -1; i >= -5; i--) {
+      deq.push_front(&deq, Job{i, 0});
+    }
+    assert(Deque_Job_save(&deq, path));
+
+    Deque_Job loaded;
+    assert(Deque_Job_open(&loaded, path, Job_less_by_id, DEQUE_FILE_READ));
+    assert(Deque_Job_equal(deq, loaded));
+    assert(loaded.front(&loaded).id == -5);
+    assert(loaded.back(&loaded).cost == 9.5);
+
+    // Read mode is copy on write and moves to the heap once it grows
+    for (int i = 20; i < 100; i++) {
+      loaded.push_back(&loaded, Job{i, 0});
+    }
+    assert(loaded.size(&loaded) == 105);
+    assert(loaded.at(&loaded, 0).id == -5 && loaded.at(&loaded, 104).id == 99);
+    loaded.dtor(&loaded);
+
+    Deque_Job again;
+    assert(Deque_Job_open(&again, path, Job_less_by_id, DEQUE_FILE_READ));
+    assert(again.size(&again) == 25);
+    again.dtor(&again);
+
+    deq.dtor(&deq);
+  }
+
+  // Append mode keeps the file in step with every push and pop
+  {
+    unlink(path);
+    Deque_Job deq;
+    assert(Deque_Job_open(&deq, path, Job_less_by_id, DEQUE_FILE_APPEND));
+    assert(deq.empty(&deq));
+    for (int i = 0; i < 1000; i++) {
+      deq.push_back(&deq, Job{i, 1.0});
+    }
+    deq.push_front(&deq, Job{-1, 1.0});
+    deq.pop_back(&deq);
+    assert(Deque_Job_flush(&deq));
+    deq.dtor(&deq);
+
+    Deque_Job reopened;
+    assert(Deque_Job_open(&reopened, path, Job_less_by_id, DEQUE_FILE_APPEND));
+    assert(reopened.size(&reopened) == 1000);
+    assert(reopened.front(&reopened).id == -1);
+    assert(reopened.back(&reopened).id == 998);
+    for (int i = 0; i < 1000; i++) {
+      assert(reopened.at(&reopened, i).id == i - 1);
+    }
+    reopened.push_back(&reopened, Job{1000, 2.0});
+    reopened.dtor(&reopened);
+
+    Deque_Job last;
+    assert(Deque_Job_open(&last, path, Job_less_by_id, DEQUE_FILE_READ));
+    assert(last.size(&last) == 1001 && last.back(&last).id == 1000);
+    last.dtor(&last);
+  }
+
+  // A file that can't grow turns pushes away instead of wrapping onto the head
+  {
+    unlink(path);
+    Deque_Job deq;
+    assert(Deque_Job_open(&deq, path, Job_less_by_id, DEQUE_FILE_APPEND));
+    for (int i = 0; i < 8; i++) {
+      assert(Deque_Job_try_push_back(&deq, Job{i, 0}));
+    }
+
+    // Going past the limit is EFBIG rather than a signal with SIGXFSZ ignored
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit old_lim;
+    getrlimit(RLIMIT_FSIZE, &old_lim);
+    struct rlimit lim = old_lim;
+    lim.rlim_cur = sizeof(DequeFile_Header) + 11 * sizeof(Job);
+    assert(setrlimit(RLIMIT_FSIZE, &lim) == 0);
+
+    // Cap is 11 and one slot always stays free
+    assert(Deque_Job_try_push_front(&deq, Job{-1, 0}));
+    assert(Deque_Job_try_push_back(&deq, Job{8, 0}));
+    errno = 0;
+    assert(!Deque_Job_try_push_back(&deq, Job{9, 0}));
+    assert(errno == EFBIG);
+    assert(!Deque_Job_try_push_front(&deq, Job{-2, 0}));
+    deq.push_back(&deq, Job{9, 0});
+    assert(deq.size(&deq) == 10);
+    for (int i = 0; i < 10; i++) {
+      assert(deq.at(&deq, i).id == i - 1);
+    }
+
+    assert(setrlimit(RLIMIT_FSIZE, &old_lim) == 0);
+    signal(SIGXFSZ, SIG_DFL);
+    assert(Deque_Job_try_push_back(&deq, Job{9, 0}));
+    deq.dtor(&deq);
+
+    Deque_Job reopened;
+    assert(Deque_Job_open(&reopened, path, Job_less_by_id, DEQUE_FILE_READ));
+    assert(reopened.size(&reopened) == 11);
+    assert(reopened.front(&reopened).id == -1 && reopened.back(&reopened).id == 9);
+    reopened.dtor(&reopened);
+  }
+
+  // Headers pointing outside the ring don't get mapped
+  {
+    Deque_Job deq;
+    Deque_Job_ctor(&deq, Job_less_by_id);
+    deq.push_back(&deq, Job{1, 0});
+    assert(Deque_Job_save(&deq, path));
+    deq.dtor(&deq);
+
+    size_t offsets[] = {offsetof(DequeFile_Header, size), offsetof(DequeFile_Header, ring_head),
+                        offsetof(DequeFile_Header, ring_tail)};
+    for (size_t off : offsets) {
+      int fd = open(path, O_RDWR);
+      uint32_t cap = 0, orig = 0;
+      assert(pread(fd, &cap, sizeof cap, offsetof(DequeFile_Header, cap)) == sizeof cap);
+      assert(pread(fd, &orig, sizeof orig, off) == sizeof orig);
+      assert(pwrite(fd, &cap, sizeof cap, off) == sizeof cap);
+      Deque_Job bad;
+      assert(!Deque_Job_open(&bad, path, Job_less_by_id, DEQUE_FILE_READ));
+      assert(!Deque_Job_open(&bad, path, Job_less_by_id, DEQUE_FILE_APPEND));
+      assert(pwrite(fd, &orig, sizeof orig, off) == sizeof orig);
+      close(fd);
+      assert(Deque_Job_open(&bad, path, Job_less_by_id, DEQUE_FILE_READ));
+      bad.dtor(&bad);
+    }
+  }
+
+  // Refuse files that aren't ours
+  {
+    FILE *f = fopen(path, "w");
+    fputs("definitely not a deque, just some text padding it out to 64 bytes....", f);
+    fclose(f);
+    Deque_Job deq;
+    assert(!Deque_Job_open(&deq, path, Job_less_by_id, DEQUE_FILE_READ));
+  }
+
+  unlink(path);
+  printf("DequeFile tests passed\n");
+}
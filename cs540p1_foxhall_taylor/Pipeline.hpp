@@ -0,0 +1,305 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+/* Needs -pthread */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Deque.hpp"
+
+#define PIPELINE_MAX_STAGES 16
+
+/* Per stage counters, times are in nanoseconds */
+typedef struct Pipeline_Stats {
+  const char *name;
+  unsigned int threads;
+  unsigned long long items_in;
+  unsigned long long items_out;
+  unsigned long long batches;
+  unsigned long long busy_ns;    /* Inside the stage fn */
+  unsigned long long stalled_ns; /* Blocked on a full downstream queue */
+  unsigned long long starved_ns; /* Waiting on an empty input queue */
+  unsigned int depth;            /* Input queue depth right now */
+  unsigned int max_depth;        /* Deepest the input queue ever got */
+  double items_per_sec;          /* items_out over start until the stage */
+                                 /* finished, or until now while it runs */
+} Pipeline_Stats;
+
+/* Needs Deque_DEFINE(_type) first. Every stage reads from a bounded */
+/* Deque backed queue and writes to the next one, the last stage is the */
+/* sink and whatever it leaves in the batch is dropped. */
+#define Pipeline_DEFINE(_type)                                          \
+                                                                        \
+  /* Stage fns get a batch to work on in place. They can drop items */  \
+  /* by compacting the batch and lowering *n */                         \
+  typedef void (*Pipeline_##_type##_Fn)(_type *batch, unsigned int *n, void *ctx); \
+                                                                        \
+  typedef struct Pipeline_##_type##_Queue {                             \
+    Deque_##_type ring;                                                 \
+    unsigned int cap;                                                   \
+    unsigned int max_depth;                                             \
+    unsigned int writers; /* Closes once the last one is done */        \
+    bool closed;                                                        \
+    std::mutex lock;                                                    \
+    std::condition_variable not_full;                                   \
+    std::condition_variable not_empty;                                  \
+  } Pipeline_##_type##_Queue;                                           \
+                                                                        \
+  typedef struct Pipeline_##_type##_Stage {                             \
+    const char *name;                                                   \
+    Pipeline_##_type##_Fn fn;                                           \
+    void *ctx;                                                          \
+    unsigned int threads;                                               \
+    std::atomic<unsigned long long> items_in;                           \
+    std::atomic<unsigned long long> items_out;                          \
+    std::atomic<unsigned long long> batches;                            \
+    std::atomic<unsigned long long> busy_ns;                            \
+    std::atomic<unsigned long long> stalled_ns;                         \
+    std::atomic<unsigned long long> starved_ns;                         \
+    std::atomic<unsigned int> running;                                  \
+    /* Since start, set once the last of its threads is done */         \
+    std::atomic<unsigned long long> done_ns;                            \
+  } Pipeline_##_type##_Stage;                                           \
+                                                                        \
+  typedef struct Pipeline_##_type {                                     \
+    /* "Private" fields */                                              \
+    unsigned int _nstages;                                              \
+    unsigned int _batch;                                                \
+    /* _queues[i] feeds stage i, _queues[0] is fed by push() */         \
+    Pipeline_##_type##_Queue _queues[PIPELINE_MAX_STAGES];              \
+    Pipeline_##_type##_Stage _stages[PIPELINE_MAX_STAGES];              \
+    std::vector<std::thread> _threads;                                  \
+    std::chrono::steady_clock::time_point _start;                       \
+                                                                        \
+    /* "Public" fields */                                               \
+    const char type_name[sizeof "Pipeline_"#_type] = "Pipeline_"#_type; \
+                                                                        \
+    /* Functions */                                                     \
+    bool (*add_stage)(Pipeline_##_type *p, const char *name,            \
+                      Pipeline_##_type##_Fn fn, void *ctx, unsigned int threads); \
+    void (*start)(Pipeline_##_type *p);                                 \
+    void (*push)(Pipeline_##_type *p, const _type elem);                \
+    void (*push_batch)(Pipeline_##_type *p, const _type *elems, unsigned int n); \
+    void (*close)(Pipeline_##_type *p);                                 \
+    void (*join)(Pipeline_##_type *p);                                  \
+    Pipeline_Stats (*stats)(Pipeline_##_type *p, unsigned int stage);   \
+    void (*dtor)(Pipeline_##_type *p);                                  \
+  } Pipeline_##_type;                                                   \
+                                                                        \
+  /* Queue implementation */                                            \
+                                                                        \
+  unsigned long long _pl_ns_since_##_type(std::chrono::steady_clock::time_point t) { \
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(        \
+      std::chrono::steady_clock::now() - t).count();                    \
+  }                                                                     \
+                                                                        \
+  /* Blocks while the queue is full, that's the backpressure */         \
+  void _pl_queue_put_##_type(Pipeline_##_type##_Queue *q, const _type *elems, \
+                             unsigned int n, Pipeline_##_type##_Stage *stalled) { \
+    unsigned int done = 0;                                              \
+    while (done < n) {                                                  \
+      std::unique_lock<std::mutex> g(q->lock);                          \
+      if ((unsigned int) q->ring.size(&q->ring) >= q->cap) {            \
+        auto t = std::chrono::steady_clock::now();                      \
+        q->not_full.wait(g, [q] {                                       \
+          return (unsigned int) q->ring.size(&q->ring) < q->cap;        \
+        });                                                             \
+        if (stalled) stalled->stalled_ns += _pl_ns_since_##_type(t);    \
+      }                                                                 \
+      while (done < n && (unsigned int) q->ring.size(&q->ring) < q->cap) { \
+        q->ring.push_back(&q->ring, elems[done++]);                     \
+      }                                                                 \
+      unsigned int depth = q->ring.size(&q->ring);                      \
+      if (depth > q->max_depth) q->max_depth = depth;                   \
+      g.unlock();                                                       \
+      q->not_empty.notify_all();                                        \
+    }                                                                   \
+  }                                                                     \
+                                                                        \
+  /* Takes up to max, 0 means closed and drained */                     \
+  unsigned int _pl_queue_take_##_type(Pipeline_##_type##_Queue *q, _type *out, \
+                                      unsigned int max, Pipeline_##_type##_Stage *starved) { \
+    std::unique_lock<std::mutex> g(q->lock);                            \
+    if (q->ring.empty(&q->ring) && !q->closed) {                        \
+      auto t = std::chrono::steady_clock::now();                        \
+      q->not_empty.wait(g, [q] {                                        \
+        return !q->ring.empty(&q->ring) || q->closed;                   \
+      });                                                               \
+      starved->starved_ns += _pl_ns_since_##_type(t);                   \
+    }                                                                   \
+    unsigned int n = 0;                                                 \
+    while (n < max && !q->ring.empty(&q->ring)) {                       \
+      out[n++] = q->ring.front(&q->ring);                               \
+      q->ring.pop_front(&q->ring);                                      \
+    }                                                                   \
+    g.unlock();                                                         \
+    if (n > 0) q->not_full.notify_all();                                \
+    return n;                                                           \
+  }                                                                     \
+                                                                        \
+  void _pl_queue_close_##_type(Pipeline_##_type##_Queue *q) {           \
+    {                                                                   \
+      std::lock_guard<std::mutex> g(q->lock);                           \
+      if (q->writers > 0 && --q->writers > 0) {                         \
+        return;                                                         \
+      }                                                                 \
+      q->closed = true;                                                 \
+    }                                                                   \
+    q->not_empty.notify_all();                                          \
+  }                                                                     \
+                                                                        \
+  /* Pipeline implementation */                                         \
+                                                                        \
+  void _pl_worker_##_type(Pipeline_##_type *p, unsigned int i) {        \
+    Pipeline_##_type##_Stage *stage = &p->_stages[i];                   \
+    Pipeline_##_type##_Queue *in = &p->_queues[i];                      \
+    Pipeline_##_type##_Queue *out = i + 1 < p->_nstages ? &p->_queues[i + 1] : nullptr; \
+    std::vector<_type> batch(p->_batch);                                \
+                                                                        \
+    unsigned int n;                                                     \
+    while ((n = _pl_queue_take_##_type(in, batch.data(), p->_batch, stage)) > 0) { \
+      stage->items_in += n;                                             \
+      stage->batches++;                                                 \
+      auto t = std::chrono::steady_clock::now();                        \
+      stage->fn(batch.data(), &n, stage->ctx);                          \
+      stage->busy_ns += _pl_ns_since_##_type(t);                        \
+      stage->items_out += n;                                            \
+      if (out && n > 0) {                                               \
+        _pl_queue_put_##_type(out, batch.data(), n, stage);             \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    if (out) {                                                          \
+      _pl_queue_close_##_type(out);                                     \
+    }                                                                   \
+    if (--stage->running == 0) {                                        \
+      stage->done_ns = std::max(1ULL, _pl_ns_since_##_type(p->_start)); \
+    }                                                                   \
+  }                                                                     \
+                                                                        \
+  bool _pl_add_stage_##_type(Pipeline_##_type *p, const char *name,     \
+                             Pipeline_##_type##_Fn fn, void *ctx, unsigned int threads) { \
+    if (p->_nstages == PIPELINE_MAX_STAGES || !p->_threads.empty()) {   \
+      /* Full up, or already running */                                 \
+      return false;                                                     \
+    }                                                                   \
+    Pipeline_##_type##_Stage *stage = &p->_stages[p->_nstages++];       \
+    stage->name = name;                                                 \
+    stage->fn = fn;                                                     \
+    stage->ctx = ctx;                                                   \
+    stage->threads = threads > 0 ? threads : 1;                         \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  void _pl_start_##_type(Pipeline_##_type *p) {                         \
+    p->_start = std::chrono::steady_clock::now();                       \
+    for (unsigned int i = 0; i < p->_nstages; i++) {                    \
+      /* Stage i's threads are the writers of queue i + 1 */            \
+      if (i + 1 < p->_nstages) {                                        \
+        p->_queues[i + 1].writers = p->_stages[i].threads;              \
+      }                                                                 \
+      p->_stages[i].running = p->_stages[i].threads;                    \
+    }                                                                   \
+    for (unsigned int i = 0; i < p->_nstages; i++) {                    \
+      for (unsigned int t = 0; t < p->_stages[i].threads; t++) {        \
+        p->_threads.emplace_back(_pl_worker_##_type, p, i);             \
+      }                                                                 \
+    }                                                                   \
+  }                                                                     \
+                                                                        \
+  void _pl_push_##_type(Pipeline_##_type *p, const _type elem) {        \
+    _pl_queue_put_##_type(&p->_queues[0], &elem, 1, nullptr);           \
+  }                                                                     \
+                                                                        \
+  void _pl_push_batch_##_type(Pipeline_##_type *p, const _type *elems, unsigned int n) { \
+    _pl_queue_put_##_type(&p->_queues[0], elems, n, nullptr);           \
+  }                                                                     \
+                                                                        \
+  void _pl_close_##_type(Pipeline_##_type *p) {                         \
+    _pl_queue_close_##_type(&p->_queues[0]);                            \
+  }                                                                     \
+                                                                        \
+  void _pl_join_##_type(Pipeline_##_type *p) {                          \
+    for (auto& t: p->_threads) {                                        \
+      if (t.joinable()) t.join();                                       \
+    }                                                                   \
+  }                                                                     \
+                                                                        \
+  Pipeline_Stats _pl_stats_##_type(Pipeline_##_type *p, unsigned int i) { \
+    Pipeline_##_type##_Stage *stage = &p->_stages[i];                   \
+    Pipeline_##_type##_Queue *q = &p->_queues[i];                       \
+    Pipeline_Stats s;                                                   \
+    s.name = stage->name;                                               \
+    s.threads = stage->threads;                                         \
+    s.items_in = stage->items_in;                                       \
+    s.items_out = stage->items_out;                                     \
+    s.batches = stage->batches;                                         \
+    s.busy_ns = stage->busy_ns;                                         \
+    s.stalled_ns = stage->stalled_ns;                                   \
+    s.starved_ns = stage->starved_ns;                                   \
+    {                                                                   \
+      std::lock_guard<std::mutex> g(q->lock);                           \
+      s.depth = q->ring.size(&q->ring);                                 \
+      s.max_depth = q->max_depth;                                       \
+    }                                                                   \
+    /* A drained stage's rate stops where it finished */                \
+    unsigned long long elapsed = stage->done_ns;                        \
+    if (elapsed == 0) {                                                 \
+      elapsed = _pl_ns_since_##_type(p->_start);                        \
+    }                                                                   \
+    s.items_per_sec = elapsed > 0 ? s.items_out * 1e9 / elapsed : 0;    \
+    return s;                                                           \
+  }                                                                     \
+                                                                        \
+  /* Joins first, so close() the pipeline before this */                \
+  void _pl_dtor_##_type(Pipeline_##_type *p) {                          \
+    _pl_join_##_type(p);                                                \
+    for (unsigned int i = 0; i < PIPELINE_MAX_STAGES; i++) {            \
+      p->_queues[i].ring.dtor(&p->_queues[i].ring);                     \
+    }                                                                   \
+    p->_threads.clear();                                                \
+  }                                                                     \
+                                                                        \
+  /* Constructor. queue_cap bounds every queue, batch is the most a */  \
+  /* stage takes or hands over in one go */                             \
+                                                                        \
+  void Pipeline_##_type##_ctor(Pipeline_##_type *p, unsigned int queue_cap, unsigned int batch) { \
+    p->_nstages = 0;                                                    \
+    p->_batch = batch > 0 ? batch : 1;                                  \
+    for (unsigned int i = 0; i < PIPELINE_MAX_STAGES; i++) {            \
+      Pipeline_##_type##_Queue *q = &p->_queues[i];                     \
+      /* Queues are never compared, so no comparison fn */              \
+      Deque_##_type##_ctor(&q->ring, nullptr);                          \
+      q->cap = queue_cap > 0 ? queue_cap : 1;                           \
+      q->max_depth = 0;                                                 \
+      q->writers = 1;                                                   \
+      q->closed = false;                                                \
+                                                                        \
+      Pipeline_##_type##_Stage *s = &p->_stages[i];                     \
+      s->name = nullptr;                                                \
+      s->fn = nullptr;                                                  \
+      s->ctx = nullptr;                                                 \
+      s->threads = 0;                                                   \
+      s->items_in = s->items_out = s->batches = 0;                      \
+      s->busy_ns = s->stalled_ns = s->starved_ns = 0;                   \
+      s->running = 0;                                                   \
+      s->done_ns = 0;                                                   \
+    }                                                                   \
+                                                                        \
+    p->add_stage = &_pl_add_stage_##_type;                              \
+    p->start = &_pl_start_##_type;                                      \
+    p->push = &_pl_push_##_type;                                        \
+    p->push_batch = &_pl_push_batch_##_type;                            \
+    p->close = &_pl_close_##_type;                                      \
+    p->join = &_pl_join_##_type;                                        \
+    p->stats = &_pl_stats_##_type;                                      \
+    p->dtor = &_pl_dtor_##_type;                                        \
+  }
+
+#endif /* _PIPELINE_H_ */
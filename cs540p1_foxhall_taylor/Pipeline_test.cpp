@@ -0,0 +1,100 @@
+/*
+ * Compile with -pthread.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include "Pipeline.hpp"
+
+struct Record {
+  long raw;
+  long value;
+};
+
+Deque_DEFINE(Record)
+Pipeline_DEFINE(Record)
+
+void
+parse(Record *batch, unsigned int *n, void *) {
+  for (unsigned int i = 0; i < *n; i++) {
+    batch[i].value = batch[i].raw * 2;
+  }
+}
+
+// Drops every record whose raw value is a multiple of 3
+void
+transform(Record *batch, unsigned int *n, void *) {
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < *n; i++) {
+    if (batch[i].raw % 3 != 0) {
+      batch[kept++] = batch[i];
+    }
+  }
+  *n = kept;
+}
+
+void
+write_out(Record *batch, unsigned int *n, void *ctx) {
+  std::atomic<long> *sum = (std::atomic<long> *) ctx;
+  long local = 0;
+  for (unsigned int i = 0; i < *n; i++) {
+    local += batch[i].value;
+  }
+  *sum += local;
+  // Slow sink, so the queues upstream back up
+  std::this_thread::sleep_for(std::chrono::microseconds(20));
+}
+
+int
+main() {
+  const long count = 200000;
+  std::atomic<long> sum(0);
+
+  Pipeline_Record p;
+  Pipeline_Record_ctor(&p, 256, 32);
+  assert(p.add_stage(&p, "parse", parse, nullptr, 2));
+  assert(p.add_stage(&p, "transform", transform, nullptr, 3));
+  assert(p.add_stage(&p, "write", write_out, &sum, 1));
+  p.start(&p);
+  // Can't change the shape once it's running
+  assert(!p.add_stage(&p, "late", write_out, &sum, 1));
+
+  Record chunk[100];
+  for (long i = 0; i < count; i += 100) {
+    for (long j = 0; j < 100; j++) {
+      chunk[j] = Record{i + j, 0};
+    }
+    p.push_batch(&p, chunk, 100);
+  }
+  p.close(&p);
+  p.join(&p);
+
+  long expected = 0;
+  for (long i = 0; i < count; i++) {
+    if (i % 3 != 0) expected += 2 * i;
+  }
+  assert(sum == expected);
+
+  for (unsigned int i = 0; i < 3; i++) {
+    Pipeline_Stats s = p.stats(&p, i);
+    printf("%-10s threads %u in %llu out %llu batches %llu max depth %u "
+           "stalled %.1f ms starved %.1f ms %.0f items/s\n",
+           s.name, s.threads, s.items_in, s.items_out, s.batches, s.max_depth,
+           s.stalled_ns / 1e6, s.starved_ns / 1e6, s.items_per_sec);
+    assert(s.depth == 0);
+    assert(s.max_depth <= 256);
+  }
+  assert(p.stats(&p, 0).items_in == (unsigned long long) count);
+  assert(p.stats(&p, 2).items_in == (unsigned long long) (count - (count + 2) / 3));
+  // The sink is the bottleneck, so transform spends time stalled on it
+  assert(p.stats(&p, 1).stalled_ns > 0);
+
+  // Rates are over the time each stage ran, so they hold still once drained
+  double rate = p.stats(&p, 2).items_per_sec;
+  assert(rate > 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  assert(p.stats(&p, 2).items_per_sec == rate);
+
+  p.dtor(&p);
+  printf("Pipeline tests passed\n");
+}
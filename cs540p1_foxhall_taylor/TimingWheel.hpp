@@ -0,0 +1,255 @@
+#ifndef _TIMING_WHEEL_H_
+#define _TIMING_WHEEL_H_
+
+#include <stdlib.h>
+
+#include "Deque.hpp"
+
+/* 5 levels of 64 slots covers 2^30 ticks, anything further out is */
+/* parked in the top level and re-placed every time it cascades */
+#define TIMING_WHEEL_BITS   6
+#define TIMING_WHEEL_SLOTS  (1u << TIMING_WHEEL_BITS)
+#define TIMING_WHEEL_MASK   (TIMING_WHEEL_SLOTS - 1)
+#define TIMING_WHEEL_LEVELS 5
+
+/* Timer states */
+#define TIMING_WHEEL_FREE      0
+#define TIMING_WHEEL_LIVE      1
+#define TIMING_WHEEL_CANCELLED 2 /* Still sitting in a slot, freed when the slot is swept */
+
+/* Slots hold indices into the timer table, cancel just flips the */
+/* entry to cancelled so it's O(1) and the sweep does the unlinking */
+#define TimingWheel_DEFINE(_type)                                       \
+                                                                        \
+  typedef unsigned int TimingWheel_##_type##_Slot;                      \
+  Deque_DEFINE(TimingWheel_##_type##_Slot)                              \
+                                                                        \
+  typedef struct TimingWheel_##_type##_Timer {                          \
+    _type data;                                                         \
+    unsigned long long expires;                                         \
+    unsigned int gen;                                                   \
+    unsigned int next_free;                                             \
+    unsigned char state;                                                \
+  } TimingWheel_##_type##_Timer;                                        \
+                                                                        \
+  /* What schedule() hands back, stale handles are ignored by cancel */ \
+  typedef struct TimingWheel_##_type##_Handle {                         \
+    unsigned int idx;                                                   \
+    unsigned int gen;                                                   \
+  } TimingWheel_##_type##_Handle;                                       \
+                                                                        \
+  typedef struct TimingWheel_##_type {                                  \
+    /* "Private" fields */                                              \
+    unsigned long long _next; /* The next tick advance() will run */    \
+    unsigned int _live;                                                 \
+                                                                        \
+    TimingWheel_##_type##_Timer *_timers;                               \
+    unsigned int _timers_len;                                           \
+    unsigned int _timers_cap;                                           \
+    unsigned int _free_head;                                            \
+                                                                        \
+    Deque_TimingWheel_##_type##_Slot _slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS]; \
+                                                                        \
+    /* "Public" fields */                                               \
+    const char type_name[sizeof "TimingWheel_"#_type] = "TimingWheel_"#_type; \
+                                                                        \
+    /* Functions */                                                     \
+    int (*size)(const TimingWheel_##_type *tw);                         \
+    unsigned long long (*now)(const TimingWheel_##_type *tw);           \
+    TimingWheel_##_type##_Handle (*schedule)(TimingWheel_##_type *tw, _type data, unsigned long long delay); \
+    bool (*cancel)(TimingWheel_##_type *tw, TimingWheel_##_type##_Handle h); \
+    unsigned int (*advance)(TimingWheel_##_type *tw, unsigned long long ticks, \
+                            void (*fire)(_type &data, void *ctx), void *ctx); \
+    void (*dtor)(TimingWheel_##_type *tw);                              \
+  } TimingWheel_##_type;                                                \
+                                                                        \
+  /* Implementations */                                                 \
+                                                                        \
+  int _tw_size_##_type(const TimingWheel_##_type *tw) {                 \
+    return tw->_live;                                                   \
+  }                                                                     \
+                                                                        \
+  unsigned long long _tw_now_##_type(const TimingWheel_##_type *tw) {   \
+    return tw->_next - 1;                                               \
+  }                                                                     \
+                                                                        \
+  unsigned int _tw_alloc_##_type(TimingWheel_##_type *tw) {             \
+    if (tw->_free_head != (unsigned int) -1) {                          \
+      unsigned int idx = tw->_free_head;                                \
+      tw->_free_head = tw->_timers[idx].next_free;                      \
+      return idx;                                                       \
+    }                                                                   \
+    if (tw->_timers_len == tw->_timers_cap) {                           \
+      tw->_timers_cap *= 2;                                             \
+      tw->_timers = (TimingWheel_##_type##_Timer *) realloc(tw->_timers, \
+        tw->_timers_cap * sizeof(TimingWheel_##_type##_Timer));         \
+    }                                                                   \
+    tw->_timers[tw->_timers_len].gen = 0;                               \
+    return tw->_timers_len++;                                           \
+  }                                                                     \
+                                                                        \
+  void _tw_free_##_type(TimingWheel_##_type *tw, unsigned int idx) {    \
+    tw->_timers[idx].state = TIMING_WHEEL_FREE;                         \
+    tw->_timers[idx].gen++;                                             \
+    tw->_timers[idx].next_free = tw->_free_head;                        \
+    tw->_free_head = idx;                                               \
+  }                                                                     \
+                                                                        \
+  /* Drop a timer in the slot its deadline falls in relative to _next */ \
+  void _tw_place_##_type(TimingWheel_##_type *tw, unsigned int idx) {   \
+    unsigned long long expires = tw->_timers[idx].expires;              \
+    unsigned long long delta = expires - tw->_next;                     \
+    if (expires < tw->_next) {                                          \
+      /* Overdue, run it on the next tick */                            \
+      expires = tw->_next;                                              \
+      delta = 0;                                                        \
+    }                                                                   \
+                                                                        \
+    int level = 0;                                                      \
+    while (level < TIMING_WHEEL_LEVELS - 1 &&                           \
+           delta >= (1ull << (TIMING_WHEEL_BITS * (level + 1)))) {      \
+      level++;                                                          \
+    }                                                                   \
+    if (delta >= (1ull << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS))) { \
+      /* Past the end of the wheel, park it as far out as we can */     \
+      expires = tw->_next + (1ull << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS)) - 1; \
+    }                                                                   \
+                                                                        \
+    unsigned int slot = (expires >> (TIMING_WHEEL_BITS * level)) & TIMING_WHEEL_MASK; \
+    Deque_TimingWheel_##_type##_Slot *bucket = &tw->_slots[level][slot]; \
+    bucket->push_back(bucket, idx);                                     \
+  }                                                                     \
+                                                                        \
+  TimingWheel_##_type##_Handle _tw_schedule_##_type(TimingWheel_##_type *tw, _type data, unsigned long long delay) { \
+    unsigned int idx = _tw_alloc_##_type(tw);                           \
+    TimingWheel_##_type##_Timer *t = &tw->_timers[idx];                 \
+    t->data = data;                                                     \
+    /* A delay of 0 still has to wait for the next tick */              \
+    t->expires = tw->_next - 1 + (delay > 0 ? delay : 1);               \
+    t->state = TIMING_WHEEL_LIVE;                                       \
+    tw->_live++;                                                        \
+    _tw_place_##_type(tw, idx);                                         \
+                                                                        \
+    TimingWheel_##_type##_Handle h;                                     \
+    h.idx = idx;                                                        \
+    h.gen = t->gen;                                                     \
+    return h;                                                           \
+  }                                                                     \
+                                                                        \
+  bool _tw_cancel_##_type(TimingWheel_##_type *tw, TimingWheel_##_type##_Handle h) { \
+    if (h.idx >= tw->_timers_len) {                                     \
+      return false;                                                     \
+    }                                                                   \
+    TimingWheel_##_type##_Timer *t = &tw->_timers[h.idx];               \
+    if (t->gen != h.gen || t->state != TIMING_WHEEL_LIVE) {             \
+      /* Already fired or cancelled */                                  \
+      return false;                                                     \
+    }                                                                   \
+    t->state = TIMING_WHEEL_CANCELLED;                                  \
+    tw->_live--;                                                        \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  /* Move everything in a higher level slot down, returns the slot */   \
+  unsigned int _tw_cascade_##_type(TimingWheel_##_type *tw, int level) { \
+    unsigned int slot = (tw->_next >> (TIMING_WHEEL_BITS * level)) & TIMING_WHEEL_MASK; \
+    Deque_TimingWheel_##_type##_Slot *bucket = &tw->_slots[level][slot]; \
+    /* Only take what's there now, placing can land back in this slot */ \
+    int n = bucket->size(bucket);                                       \
+    for (int i = 0; i < n; i++) {                                       \
+      unsigned int idx = bucket->front(bucket);                         \
+      bucket->pop_front(bucket);                                        \
+      if (tw->_timers[idx].state == TIMING_WHEEL_CANCELLED) {           \
+        _tw_free_##_type(tw, idx);                                      \
+      }                                                                 \
+      else {                                                            \
+        _tw_place_##_type(tw, idx);                                     \
+      }                                                                 \
+    }                                                                   \
+    return slot;                                                        \
+  }                                                                     \
+                                                                        \
+  unsigned int _tw_advance_##_type(TimingWheel_##_type *tw, unsigned long long ticks, \
+                                   void (*fire)(_type &data, void *ctx), void *ctx) { \
+    unsigned int fired = 0;                                             \
+    for (unsigned long long i = 0; i < ticks; i++) {                    \
+      /* Nothing left to fire, so skip straight to the end. Cancelled */ \
+      /* leftovers get freed whenever their slot is swept */            \
+      if (tw->_live == 0) {                                             \
+        tw->_next += ticks - i;                                         \
+        break;                                                          \
+      }                                                                 \
+                                                                        \
+      unsigned int slot = tw->_next & TIMING_WHEEL_MASK;                \
+      if (slot == 0) {                                                  \
+        for (int level = 1; level < TIMING_WHEEL_LEVELS; level++) {     \
+          if (_tw_cascade_##_type(tw, level) != 0) {                    \
+            break;                                                      \
+          }                                                             \
+        }                                                               \
+      }                                                                 \
+                                                                        \
+      /* The whole slot expires in one batch. Anything fire() */        \
+      /* schedules goes in after _next so it can't land in here */      \
+      Deque_TimingWheel_##_type##_Slot *bucket = &tw->_slots[0][slot];  \
+      unsigned long long tick = tw->_next++;                            \
+      int n = bucket->size(bucket);                                     \
+      for (int j = 0; j < n; j++) {                                     \
+        unsigned int idx = bucket->front(bucket);                       \
+        bucket->pop_front(bucket);                                      \
+        TimingWheel_##_type##_Timer *t = &tw->_timers[idx];             \
+        if (t->state == TIMING_WHEEL_LIVE && t->expires > tick) {       \
+          /* Shouldn't happen, but don't fire early */                  \
+          _tw_place_##_type(tw, idx);                                   \
+          continue;                                                     \
+        }                                                               \
+        if (t->state == TIMING_WHEEL_LIVE) {                            \
+          tw->_live--;                                                  \
+          fired++;                                                      \
+          /* Copy out first, fire() may schedule and move _timers */    \
+          _type data = t->data;                                         \
+          _tw_free_##_type(tw, idx);                                    \
+          fire(data, ctx);                                              \
+        }                                                               \
+        else {                                                          \
+          _tw_free_##_type(tw, idx);                                    \
+        }                                                               \
+      }                                                                 \
+    }                                                                   \
+    return fired;                                                       \
+  }                                                                     \
+                                                                        \
+  void _tw_dtor_##_type(TimingWheel_##_type *tw) {                      \
+    for (int l = 0; l < TIMING_WHEEL_LEVELS; l++) {                     \
+      for (unsigned int s = 0; s < TIMING_WHEEL_SLOTS; s++) {           \
+        tw->_slots[l][s].dtor(&tw->_slots[l][s]);                       \
+      }                                                                 \
+    }                                                                   \
+    free(tw->_timers);                                                  \
+    tw->_timers = nullptr;                                              \
+  }                                                                     \
+                                                                        \
+  /* Constructor, the clock starts at tick 0 */                         \
+                                                                        \
+  void TimingWheel_##_type##_ctor(TimingWheel_##_type *tw) {            \
+    tw->_next = 1;                                                      \
+    tw->_live = 0;                                                      \
+    tw->_timers_len = 0;                                                \
+    tw->_timers_cap = 16;                                               \
+    tw->_free_head = (unsigned int) -1;                                 \
+    tw->_timers = (TimingWheel_##_type##_Timer *) malloc(tw->_timers_cap * sizeof(TimingWheel_##_type##_Timer)); \
+    for (int l = 0; l < TIMING_WHEEL_LEVELS; l++) {                     \
+      for (unsigned int s = 0; s < TIMING_WHEEL_SLOTS; s++) {           \
+        Deque_TimingWheel_##_type##_Slot_ctor(&tw->_slots[l][s], nullptr); \
+      }                                                                 \
+    }                                                                   \
+                                                                        \
+    tw->size = &_tw_size_##_type;                                       \
+    tw->now = &_tw_now_##_type;                                         \
+    tw->schedule = &_tw_schedule_##_type;                               \
+    tw->cancel = &_tw_cancel_##_type;                                   \
+    tw->advance = &_tw_advance_##_type;                                 \
+    tw->dtor = &_tw_dtor_##_type;                                       \
+  }
+
+#endif /* _TIMING_WHEEL_H_ */
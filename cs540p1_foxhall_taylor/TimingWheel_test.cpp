@@ -0,0 +1,106 @@
+#include <assert.h>
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "TimingWheel.hpp"
+
+struct Timeout {
+  int id;
+  unsigned long long due;
+};
+
+TimingWheel_DEFINE(Timeout)
+
+struct Seen {
+  TimingWheel_Timeout *tw;
+  std::vector<int> fired;
+  int late;
+};
+
+void
+check_fire(Timeout &t, void *ctx) {
+  Seen *seen = (Seen *) ctx;
+  if (seen->tw->now(seen->tw) != t.due) {
+    seen->late++;
+  }
+  seen->fired.push_back(t.id);
+}
+
+// Reschedules itself a few times from inside the callback
+void
+rearm(Timeout &t, void *ctx) {
+  Seen *seen = (Seen *) ctx;
+  seen->fired.push_back(t.id);
+  if (t.id < 5) {
+    Timeout next{t.id + 1, seen->tw->now(seen->tw) + 64};
+    seen->tw->schedule(seen->tw, next, 64);
+  }
+}
+
+int
+main() {
+  // Everything fires exactly on its tick, across several levels
+  {
+    TimingWheel_Timeout tw;
+    TimingWheel_Timeout_ctor(&tw);
+    Seen seen{&tw, {}, 0};
+
+    std::default_random_engine e;
+    std::uniform_int_distribution<unsigned long long> delay(0, 300000);
+    std::vector<TimingWheel_Timeout_Handle> handles;
+    for (int i = 0; i < 20000; i++) {
+      unsigned long long d = delay(e);
+      Timeout t{i, tw.now(&tw) + (d > 0 ? d : 1)};
+      handles.push_back(tw.schedule(&tw, t, d));
+    }
+    assert(tw.size(&tw) == 20000);
+
+    // Cancel every other one, twice to make sure the second is a no-op
+    for (size_t i = 0; i < handles.size(); i += 2) {
+      assert(tw.cancel(&tw, handles[i]));
+      assert(!tw.cancel(&tw, handles[i]));
+    }
+    assert(tw.size(&tw) == 10000);
+
+    unsigned int fired = tw.advance(&tw, 300001, check_fire, &seen);
+    assert(fired == 10000 && seen.fired.size() == 10000);
+    assert(seen.late == 0);
+    for (int id: seen.fired) {
+      assert(id % 2 == 1);
+    }
+    assert(tw.size(&tw) == 0);
+
+    // Handles of fired timers are stale now
+    assert(!tw.cancel(&tw, handles[1]));
+    tw.dtor(&tw);
+  }
+
+  // Way out in the top level still fires on time
+  {
+    TimingWheel_Timeout tw;
+    TimingWheel_Timeout_ctor(&tw);
+    Seen seen{&tw, {}, 0};
+    unsigned long long far = (1ull << 25) + 12345;
+    tw.schedule(&tw, Timeout{7, far}, far);
+    tw.advance(&tw, far - 1, check_fire, &seen);
+    assert(seen.fired.empty());
+    tw.advance(&tw, 1, check_fire, &seen);
+    assert(seen.fired.size() == 1 && seen.late == 0);
+    tw.dtor(&tw);
+  }
+
+  // Scheduling from inside fire() doesn't get swept up by the same tick
+  {
+    TimingWheel_Timeout tw;
+    TimingWheel_Timeout_ctor(&tw);
+    Seen seen{&tw, {}, 0};
+    tw.schedule(&tw, Timeout{0, 64}, 64);
+    tw.advance(&tw, 64, rearm, &seen);
+    assert(seen.fired.size() == 1);
+    tw.advance(&tw, 64 * 5, rearm, &seen);
+    assert(seen.fired.size() == 6 && tw.size(&tw) == 0);
+    tw.dtor(&tw);
+  }
+
+  printf("TimingWheel tests passed\n");
+}
@@ -327,6 +327,42 @@ main() {
         
   }
 
+  // Test clone and assign, including a ring that has wrapped around.
+  {
+    Deque_int deq, copy1, copy2, copy3;
+    Deque_int_ctor(&deq, int_less);
+    for (int i = 0; i < 8; i++) {
+      deq.push_back(&deq, i);
+    }
+    for (int i = -1; i > -5; i--) {
+      deq.push_front(&deq, i);
+    }
+
+    Deque_int_clone(&copy1, &deq, false);
+    Deque_int_clone(&copy2, &deq, true);
+    assert(Deque_int_equal(deq, copy1));
+    assert(Deque_int_equal(deq, copy2));
+    assert(copy2._cap == (unsigned) deq.size(&deq) + 1);
+    assert(copy2.at(&copy2, 0) == -4 && copy2._ring_head == 0);
+
+    // Copies don't share storage and still grow.
+    copy2.push_back(&copy2, 100);
+    copy2.push_front(&copy2, -100);
+    assert(copy2.back(&copy2) == 100 && copy2.front(&copy2) == -100);
+    assert(deq.back(&deq) == 7 && deq.front(&deq) == -4);
+
+    Deque_int_ctor(&copy3, int_less);
+    Deque_int_assign(&copy3, &copy2);
+    assert(Deque_int_equal(copy3, copy2));
+    Deque_int_assign(&copy3, &deq);
+    assert(Deque_int_equal(copy3, deq));
+
+    deq.dtor(&deq);
+    copy1.dtor(&copy1);
+    copy2.dtor(&copy2);
+    copy3.dtor(&copy3);
+  }
+
   // Test performance.
   {
     std::default_random_engine e;
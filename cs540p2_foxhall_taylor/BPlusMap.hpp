@@ -0,0 +1,1027 @@
+#ifndef _BPLUS_MAP_H_
+#define _BPLUS_MAP_H_
+
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Map.hpp"
+
+namespace cs540 {
+  // How many of something fit in a node, never less than 4
+  constexpr size_t _bplus_slots(size_t bytes, size_t each) {
+    return bytes / each < 4 ? 4 : bytes / each;
+  }
+
+  // Same interface as Map for the basics, but it's a B+tree. Elements live
+  // inline in the leaves, sorted, and the leaves are linked both ways, so a
+  // scan walks arrays a few cache lines long instead of chasing a pointer per
+  // element. Inner nodes only hold separator keys and child pointers, sized
+  // so a node is a handful of cache lines.
+  //
+  // The catch is that elements move around when their leaf splits, merges or
+  // shifts, so unlike Map, any insert or erase invalidates iterators and
+  // references into the map.
+  template <typename Key_T, typename Mapped_T>
+  class BPlusMap {
+  public:
+    using ValueType = std::pair<const Key_T, Mapped_T>;
+    using Compare = typename KeyCompare<Key_T>::type;
+
+    static const size_t CACHE_LINE = 64;
+    static const size_t NODE_BYTES = 8 * CACHE_LINE;
+
+  private:
+    // Separators get copied out of the leaves, so they can't be const
+    using StoredKey = typename std::remove_const<Key_T>::type;
+
+    struct Node {
+      bool leaf;
+      // Values in a leaf, keys in an inner node (which has one more child)
+      size_t count;
+    };
+
+  public:
+    // Elements per leaf and separators per inner node
+    static constexpr size_t LEAF_SLOTS = _bplus_slots(NODE_BYTES - sizeof(Node) - 2 * sizeof(void *), sizeof(ValueType));
+    static constexpr size_t INNER_SLOTS = _bplus_slots(NODE_BYTES - sizeof(Node) - sizeof(void *),
+                                                 sizeof(StoredKey) + sizeof(void *));
+
+  private:
+    // Nodes below this get merged with or topped up from a sibling on erase.
+    // The root gets a pass.
+    static constexpr size_t LEAF_MIN = LEAF_SLOTS / 2;
+    static constexpr size_t INNER_MIN = INNER_SLOTS / 2;
+    // Every inner node has at least two children, so this is plenty
+    static const int MAX_DEPTH = 64;
+
+    template <typename T>
+    using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    struct Leaf: Node {
+      Leaf *prev;
+      Leaf *next;
+      Slot<ValueType> slots[LEAF_SLOTS];
+
+      ValueType *at(size_t i) {
+        return reinterpret_cast<ValueType *>(&slots[i]);
+      }
+      const ValueType *at(size_t i) const {
+        return reinterpret_cast<const ValueType *>(&slots[i]);
+      }
+      const Key_T& key(size_t i) const {
+        return at(i)->first;
+      }
+    };
+
+    struct Inner: Node {
+      // Child i holds the keys from key(i - 1) up to but not including key(i)
+      Slot<StoredKey> keys[INNER_SLOTS];
+      Node *child[INNER_SLOTS + 1];
+
+      StoredKey *key(size_t i) {
+        return reinterpret_cast<StoredKey *>(&keys[i]);
+      }
+      const StoredKey *key(size_t i) const {
+        return reinterpret_cast<const StoredKey *>(&keys[i]);
+      }
+    };
+
+  public:
+    // Constructors and assignment ops
+    BPlusMap();
+    BPlusMap(const BPlusMap&);
+    BPlusMap& operator=(const BPlusMap&);
+    // Moved from maps are left empty
+    BPlusMap(BPlusMap&&);
+    BPlusMap& operator=(BPlusMap&&);
+    BPlusMap(std::initializer_list<ValueType>);
+    ~BPlusMap();
+
+    // Size
+    size_t size() const;
+    bool empty() const;
+
+    // Iterators, a leaf and a slot in it. end() is one past the last slot of
+    // the last leaf.
+    class Iterator;
+    class ConstIterator;
+    class ReverseIterator;
+
+    Iterator begin();
+    Iterator end();
+    ConstIterator begin() const;
+    ConstIterator end() const;
+    ReverseIterator rbegin();
+    ReverseIterator rend();
+
+    // Element access
+    Iterator find(const Key_T&);
+    ConstIterator find(const Key_T&) const;
+    Mapped_T& at(const Key_T&);
+    const Mapped_T& at(const Key_T&) const;
+    Mapped_T& operator[](const Key_T&);
+    size_t count(const Key_T&) const;
+    Compare key_comp() const;
+
+    // Ranges, same meaning as in Map
+    Iterator lower_bound(const Key_T&);
+    ConstIterator lower_bound(const Key_T&) const;
+    Iterator upper_bound(const Key_T&);
+    ConstIterator upper_bound(const Key_T&) const;
+
+    // Modifiers
+    std::pair<Iterator, bool> insert(const ValueType&);
+    std::pair<Iterator, bool> insert(ValueType&&);
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(const Key_T&, Args&&...);
+    // Sorted input fills leaves all the way, see _split_leaf
+    template <typename IT_T>
+    void insert(IT_T range_beg, IT_T range_end);
+    void erase(Iterator pos);
+    void erase(const Key_T&);
+    void clear();
+
+    // Comparison
+    friend bool operator==(const BPlusMap& map1, const BPlusMap& map2) {
+      if (map1.size() != map2.size()) return false;
+
+      auto it1 = map1.begin();
+      auto it2 = map2.begin();
+      while (it1 != map1.end() && *it1 == *it2) {
+        ++it1; ++it2;
+      }
+
+      return it1 == map1.end();
+    }
+
+    friend bool operator!=(const BPlusMap& map1, const BPlusMap& map2) {
+      return !(map1 == map2);
+    }
+
+    friend bool operator<(const BPlusMap& map1, const BPlusMap& map2) {
+      auto it1 = map1.begin();
+      auto it2 = map2.begin();
+      while (it1 != map1.end() && it2 != map2.end()) {
+        if (*it1 < *it2) {
+          return true;
+        }
+        if (*it2 < *it1) {
+          return false;
+        }
+        ++it1; ++it2;
+      }
+
+      return map1.size() < map2.size();
+    }
+
+  private:
+    // Slots are raw storage, so everything gets moved by hand
+    template <typename T>
+    static void _move_slot(T *to, T *from) {
+      new (to) T(std::move(*from));
+      from->~T();
+    }
+    // Opens a one slot gap at i in [0, n), or closes the one there
+    template <typename T>
+    static void _open_gap(T *first, size_t i, size_t n) {
+      for (size_t j = n; j > i; j--) {
+        _move_slot(first + j, first + j - 1);
+      }
+    }
+    template <typename T>
+    static void _close_gap(T *first, size_t i, size_t n) {
+      for (size_t j = i; j + 1 < n; j++) {
+        _move_slot(first + j, first + j + 1);
+      }
+    }
+    // Shifts all n up by k
+    template <typename T>
+    static void _open_gap_by(T *first, size_t k, size_t n) {
+      for (size_t j = n; j > 0; j--) {
+        _move_slot(first + j - 1 + k, first + j - 1);
+      }
+    }
+
+    // First slot not less than key, or first child that could hold it
+    template <typename K>
+    size_t _leaf_lower(const Leaf *, const K&) const;
+    template <typename K>
+    size_t _child_index(const Inner *, const K&) const;
+    // Walks down to key's leaf, path and pos say which child got taken at
+    // each inner level from the root down
+    Leaf *_descend(const Key_T&, Inner **path, size_t *pos) const;
+    template <typename... Args>
+    std::pair<Iterator, bool> _emplace(const Key_T&, Args&&...);
+    // Moves the back of a full leaf into a new one linked in after it, i is
+    // where the new element was headed
+    Leaf *_split_leaf(Leaf *, size_t i);
+    // Puts right back into leaf and drops it, also how leaves merge
+    void _unsplit_leaf(Leaf *, Leaf *right);
+    static void _put_child(Inner *, size_t p, StoredKey *sep, Node *child);
+    // Hooks right in after path[depth - 1]'s child, splitting upward
+    void _insert_child(Inner **path, size_t *pos, int depth, const StoredKey& sep, Node *right);
+    void _erase_at(Inner **path, size_t *pos, Leaf *, size_t i);
+    void _rebalance_leaf(Inner **path, size_t *pos, int depth);
+    void _rebalance_inner(Inner **path, size_t *pos, int depth);
+    // Takes child s + 1 and separator s out of parent, then fixes parent
+    void _remove_child(Inner **path, size_t *pos, int depth, size_t s);
+
+    Leaf *_new_leaf();
+    Inner *_new_inner();
+    Node *_clone(const Node *, Leaf *& last);
+    void _free(Node *);
+    void _swap(BPlusMap&);
+
+    Compare _cmp;
+    Node *_root;
+    // Inner levels above the leaves
+    int _depth;
+    Leaf *_first;
+    Leaf *_last;
+    size_t _size;
+
+  public:
+    class Iterator {
+    public:
+      Iterator() = delete;
+      Iterator(Leaf *leaf, size_t i): _leaf(leaf), _i(i) {}
+      Iterator(const Iterator&) = default;
+      Iterator& operator=(const Iterator&) = default;
+      ~Iterator() = default;
+
+      Iterator& operator++() {
+        if (++_i == _leaf->count && _leaf->next != nullptr) {
+          _leaf = _leaf->next;
+          _i = 0;
+        }
+        return *this;
+      }
+      Iterator operator++(int) {
+        Iterator t(*this);
+        ++(*this);
+        return t;
+      }
+      Iterator& operator--() {
+        if (_i == 0) {
+          _leaf = _leaf->prev;
+          _i = _leaf->count;
+        }
+        _i--;
+        return *this;
+      }
+      Iterator operator--(int) {
+        Iterator t(*this);
+        --(*this);
+        return t;
+      }
+      ValueType& operator*() const {
+        return *_leaf->at(_i);
+      }
+      ValueType *operator->() const {
+        return _leaf->at(_i);
+      }
+      friend bool operator==(const Iterator& i1, const Iterator& i2) {
+        return i1._leaf == i2._leaf && i1._i == i2._i;
+      }
+      friend bool operator!=(const Iterator& i1, const Iterator& i2) {
+        return !(i1 == i2);
+      }
+    private:
+      friend class BPlusMap;
+      friend class ConstIterator;
+      Leaf *_leaf;
+      size_t _i;
+    };
+    class ConstIterator {
+    public:
+      ConstIterator() = delete;
+      ConstIterator(const Leaf *leaf, size_t i): _leaf(leaf), _i(i) {}
+      ConstIterator(const Iterator& it): _leaf(it._leaf), _i(it._i) {}
+      ConstIterator(const ConstIterator&) = default;
+      ConstIterator& operator=(const ConstIterator&) = default;
+      ~ConstIterator() = default;
+
+      ConstIterator& operator++() {
+        if (++_i == _leaf->count && _leaf->next != nullptr) {
+          _leaf = _leaf->next;
+          _i = 0;
+        }
+        return *this;
+      }
+      ConstIterator operator++(int) {
+        ConstIterator t(*this);
+        ++(*this);
+        return t;
+      }
+      ConstIterator& operator--() {
+        if (_i == 0) {
+          _leaf = _leaf->prev;
+          _i = _leaf->count;
+        }
+        _i--;
+        return *this;
+      }
+      ConstIterator operator--(int) {
+        ConstIterator t(*this);
+        --(*this);
+        return t;
+      }
+      const ValueType& operator*() const {
+        return *_leaf->at(_i);
+      }
+      const ValueType *operator->() const {
+        return _leaf->at(_i);
+      }
+      // Iterators convert, so these cover mixed compares too
+      friend bool operator==(const ConstIterator& i1, const ConstIterator& i2) {
+        return i1._leaf == i2._leaf && i1._i == i2._i;
+      }
+      friend bool operator!=(const ConstIterator& i1, const ConstIterator& i2) {
+        return !(i1 == i2);
+      }
+    private:
+      const Leaf *_leaf;
+      size_t _i;
+    };
+    // Goes back to front, rend() is a null leaf
+    class ReverseIterator {
+    public:
+      ReverseIterator() = delete;
+      ReverseIterator(Leaf *leaf, size_t i): _leaf(leaf), _i(i) {}
+      ReverseIterator(const ReverseIterator&) = default;
+      ReverseIterator& operator=(const ReverseIterator&) = default;
+      ~ReverseIterator() = default;
+
+      ReverseIterator& operator++() {
+        if (_i == 0) {
+          _leaf = _leaf->prev;
+          _i = _leaf == nullptr ? 0 : _leaf->count - 1;
+        } else {
+          _i--;
+        }
+        return *this;
+      }
+      ReverseIterator operator++(int) {
+        ReverseIterator t(*this);
+        ++(*this);
+        return t;
+      }
+      ReverseIterator& operator--() {
+        if (++_i == _leaf->count) {
+          _leaf = _leaf->next;
+          _i = 0;
+        }
+        return *this;
+      }
+      ReverseIterator operator--(int) {
+        ReverseIterator t(*this);
+        --(*this);
+        return t;
+      }
+      ValueType& operator*() const {
+        return *_leaf->at(_i);
+      }
+      ValueType *operator->() const {
+        return _leaf->at(_i);
+      }
+      friend bool operator==(const ReverseIterator& i1, const ReverseIterator& i2) {
+        return i1._leaf == i2._leaf && i1._i == i2._i;
+      }
+      friend bool operator!=(const ReverseIterator& i1, const ReverseIterator& i2) {
+        return !(i1 == i2);
+      }
+    private:
+      Leaf *_leaf;
+      size_t _i;
+    };
+  };
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>::BPlusMap():
+    _cmp(),
+    _root(nullptr),
+    _depth(0),
+    _first(nullptr),
+    _last(nullptr),
+    _size(0) {
+    // There's always a leaf, even empty, so end() has somewhere to be
+    _first = _last = _new_leaf();
+    _root = _first;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>::BPlusMap(const BPlusMap& map):
+    _cmp(map._cmp),
+    _root(nullptr),
+    _depth(map._depth),
+    _first(nullptr),
+    _last(nullptr),
+    _size(map._size) {
+    // Same shape, leaves get linked up as they're copied in order
+    _root = _clone(map._root, _last);
+    _first = _last;
+    while (_first->prev != nullptr) {
+      _first = _first->prev;
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>& BPlusMap<Key_T, Mapped_T>::operator=(const BPlusMap& map) {
+    if (&map == this) {
+      return *this;
+    }
+    BPlusMap tmp(map);
+    _swap(tmp);
+    return *this;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>::BPlusMap(BPlusMap&& map): BPlusMap() {
+    _swap(map);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>& BPlusMap<Key_T, Mapped_T>::operator=(BPlusMap&& map) {
+    if (&map == this) {
+      return *this;
+    }
+    BPlusMap tmp(std::move(map));
+    _swap(tmp);
+    return *this;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>::BPlusMap(std::initializer_list<ValueType> init_list): BPlusMap() {
+    insert(init_list.begin(), init_list.end());
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  BPlusMap<Key_T, Mapped_T>::~BPlusMap() {
+    _free(_root);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  size_t BPlusMap<Key_T, Mapped_T>::size() const {
+    return _size;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  bool BPlusMap<Key_T, Mapped_T>::empty() const {
+    return _size == 0;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Iterator BPlusMap<Key_T, Mapped_T>::begin() {
+    return _size == 0 ? end() : Iterator(_first, 0);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Iterator BPlusMap<Key_T, Mapped_T>::end() {
+    return Iterator(_last, _last->count);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ConstIterator BPlusMap<Key_T, Mapped_T>::begin() const {
+    return _size == 0 ? end() : ConstIterator(_first, 0);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ConstIterator BPlusMap<Key_T, Mapped_T>::end() const {
+    return ConstIterator(_last, _last->count);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ReverseIterator BPlusMap<Key_T, Mapped_T>::rbegin() {
+    return _size == 0 ? rend() : ReverseIterator(_last, _last->count - 1);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ReverseIterator BPlusMap<Key_T, Mapped_T>::rend() {
+    return ReverseIterator(nullptr, 0);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename K>
+  size_t BPlusMap<Key_T, Mapped_T>::_leaf_lower(const Leaf *leaf, const K& key) const {
+    size_t lo = 0, hi = leaf->count;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (_cmp(leaf->key(mid), key)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename K>
+  size_t BPlusMap<Key_T, Mapped_T>::_child_index(const Inner *in, const K& key) const {
+    // Past every separator not greater than key
+    size_t lo = 0, hi = in->count;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (_cmp(key, *in->key(mid))) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return lo;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Leaf *BPlusMap<Key_T, Mapped_T>::_descend(const Key_T& key, Inner **path, size_t *pos) const {
+    Node *n = _root;
+    for (int d = 0; d < _depth; d++) {
+      Inner *in = static_cast<Inner *>(n);
+      size_t c = _child_index(in, key);
+      if (path != nullptr) {
+        path[d] = in;
+        pos[d] = c;
+      }
+      n = in->child[c];
+    }
+    return static_cast<Leaf *>(n);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Iterator BPlusMap<Key_T, Mapped_T>::find(const Key_T& key) {
+    Leaf *leaf = _descend(key, nullptr, nullptr);
+    size_t i = _leaf_lower(leaf, key);
+    if (i == leaf->count || _cmp(key, leaf->key(i))) {
+      return end();
+    }
+    return Iterator(leaf, i);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ConstIterator BPlusMap<Key_T, Mapped_T>::find(const Key_T& key) const {
+    return const_cast<BPlusMap *>(this)->find(key);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Mapped_T& BPlusMap<Key_T, Mapped_T>::at(const Key_T& key) {
+    Iterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Key not found");
+    }
+    return it->second;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  const Mapped_T& BPlusMap<Key_T, Mapped_T>::at(const Key_T& key) const {
+    return const_cast<BPlusMap *>(this)->at(key);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Mapped_T& BPlusMap<Key_T, Mapped_T>::operator[](const Key_T& key) {
+    return try_emplace(key).first->second;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  size_t BPlusMap<Key_T, Mapped_T>::count(const Key_T& key) const {
+    return find(key) != end();
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Compare BPlusMap<Key_T, Mapped_T>::key_comp() const {
+    return _cmp;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Iterator BPlusMap<Key_T, Mapped_T>::lower_bound(const Key_T& key) {
+    Leaf *leaf = _descend(key, nullptr, nullptr);
+    size_t i = _leaf_lower(leaf, key);
+    // Off the end of this leaf means the start of the next one
+    if (i == leaf->count && leaf->next != nullptr) {
+      return Iterator(leaf->next, 0);
+    }
+    return Iterator(leaf, i);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ConstIterator BPlusMap<Key_T, Mapped_T>::lower_bound(const Key_T& key) const {
+    return const_cast<BPlusMap *>(this)->lower_bound(key);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Iterator BPlusMap<Key_T, Mapped_T>::upper_bound(const Key_T& key) {
+    Iterator it = lower_bound(key);
+    if (it != end() && !_cmp(key, it->first)) {
+      ++it;
+    }
+    return it;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::ConstIterator BPlusMap<Key_T, Mapped_T>::upper_bound(const Key_T& key) const {
+    return const_cast<BPlusMap *>(this)->upper_bound(key);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename BPlusMap<Key_T, Mapped_T>::Iterator, bool> BPlusMap<Key_T, Mapped_T>::insert(const ValueType& value) {
+    return _emplace(value.first, value);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename BPlusMap<Key_T, Mapped_T>::Iterator, bool> BPlusMap<Key_T, Mapped_T>::insert(ValueType&& value) {
+    // The key is only looked at before value gets moved from
+    return _emplace(value.first, std::move(value));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename... Args>
+  std::pair<typename BPlusMap<Key_T, Mapped_T>::Iterator, bool> BPlusMap<Key_T, Mapped_T>::try_emplace(const Key_T& key, Args&&... args) {
+    return _emplace(key, std::piecewise_construct, std::forward_as_tuple(key),
+                    std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename IT_T>
+  void BPlusMap<Key_T, Mapped_T>::insert(IT_T range_beg, IT_T range_end) {
+    for (; range_beg != range_end; ++range_beg) {
+      insert(*range_beg);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename... Args>
+  std::pair<typename BPlusMap<Key_T, Mapped_T>::Iterator, bool> BPlusMap<Key_T, Mapped_T>::_emplace(const Key_T& key, Args&&... args) {
+    Inner *path[MAX_DEPTH];
+    size_t pos[MAX_DEPTH];
+    Leaf *leaf = _descend(key, path, pos);
+    size_t i = _leaf_lower(leaf, key);
+    if (i < leaf->count && !_cmp(key, leaf->key(i))) {
+      return std::make_pair(Iterator(leaf, i), false);
+    }
+
+    if (leaf->count < LEAF_SLOTS) {
+      _open_gap(leaf->at(0), i, leaf->count);
+      try {
+        new (leaf->at(i)) ValueType(std::forward<Args>(args)...);
+      } catch (...) {
+        _close_gap(leaf->at(0), i, leaf->count + 1);
+        throw;
+      }
+      leaf->count++;
+      _size++;
+      return std::make_pair(Iterator(leaf, i), true);
+    }
+
+    // Split first and build the value where it ends up, the parent only hears
+    // about the new leaf once nothing else can throw
+    Leaf *right = _split_leaf(leaf, i);
+    Leaf *home = leaf;
+    if (i > leaf->count || leaf->count == LEAF_SLOTS) {
+      i -= leaf->count;
+      home = right;
+    }
+    _open_gap(home->at(0), i, home->count);
+    try {
+      new (home->at(i)) ValueType(std::forward<Args>(args)...);
+    } catch (...) {
+      _close_gap(home->at(0), i, home->count + 1);
+      _unsplit_leaf(leaf, right);
+      throw;
+    }
+    home->count++;
+    _size++;
+    _insert_child(path, pos, _depth, right->key(0), right);
+    return std::make_pair(Iterator(home, i), true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Leaf *BPlusMap<Key_T, Mapped_T>::_split_leaf(Leaf *leaf, size_t i) {
+    // Appending to the very end, like an ascending insert, leaves this one
+    // full and starts the next, otherwise it's half and half
+    size_t n = leaf->count;
+    size_t split = leaf->next == nullptr && i == n ? n : n / 2;
+    Leaf *right = _new_leaf();
+    for (size_t j = split; j < n; j++) {
+      _move_slot(right->at(j - split), leaf->at(j));
+    }
+    right->count = n - split;
+    leaf->count = split;
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next != nullptr) {
+      leaf->next->prev = right;
+    } else {
+      _last = right;
+    }
+    leaf->next = right;
+    return right;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_unsplit_leaf(Leaf *leaf, Leaf *right) {
+    for (size_t j = 0; j < right->count; j++) {
+      _move_slot(leaf->at(leaf->count + j), right->at(j));
+    }
+    leaf->count += right->count;
+    leaf->next = right->next;
+    if (right->next != nullptr) {
+      right->next->prev = leaf;
+    } else {
+      _last = leaf;
+    }
+    delete right;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_put_child(Inner *in, size_t p, StoredKey *sep, Node *child) {
+    // sep goes in as key p with child right after it, sep's slot is left empty
+    _open_gap(in->key(0), p, in->count);
+    _move_slot(in->key(p), sep);
+    for (size_t j = in->count + 1; j > p + 1; j--) {
+      in->child[j] = in->child[j - 1];
+    }
+    in->child[p + 1] = child;
+    in->count++;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_insert_child(Inner **path, size_t *pos, int depth, const StoredKey& sep, Node *right) {
+    Slot<StoredKey> carry_slot;
+    StoredKey *carry = reinterpret_cast<StoredKey *>(&carry_slot);
+    new (carry) StoredKey(sep);
+
+    for (int d = depth - 1; d >= 0; d--) {
+      Inner *in = path[d];
+      size_t p = pos[d];
+      if (in->count < INNER_SLOTS) {
+        _put_child(in, p, carry, right);
+        return;
+      }
+
+      // Full, so the middle key goes up a level and everything after it goes
+      // to a new node
+      size_t n = in->count;
+      size_t m = n / 2;
+      Inner *split = _new_inner();
+      for (size_t j = m + 1; j < n; j++) {
+        _move_slot(split->key(j - m - 1), in->key(j));
+      }
+      for (size_t j = m + 1; j <= n; j++) {
+        split->child[j - m - 1] = in->child[j];
+      }
+      split->count = n - m - 1;
+      in->count = m;
+
+      Slot<StoredKey> up_slot;
+      StoredKey *up = reinterpret_cast<StoredKey *>(&up_slot);
+      _move_slot(up, in->key(m));
+      if (p <= m) {
+        _put_child(in, p, carry, right);
+      } else {
+        _put_child(split, p - m - 1, carry, right);
+      }
+      _move_slot(carry, up);
+      right = split;
+    }
+
+    // Split all the way up, the tree grows a level
+    Inner *root = _new_inner();
+    _move_slot(root->key(0), carry);
+    root->child[0] = _root;
+    root->child[1] = right;
+    root->count = 1;
+    _root = root;
+    _depth++;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::erase(Iterator pos) {
+    // Find the way down to its leaf again, the key is only read until
+    // _erase_at destroys it
+    Inner *path[MAX_DEPTH];
+    size_t at[MAX_DEPTH];
+    Leaf *leaf = _descend(pos->first, path, at);
+    _erase_at(path, at, leaf, pos._i);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::erase(const Key_T& key) {
+    Inner *path[MAX_DEPTH];
+    size_t pos[MAX_DEPTH];
+    Leaf *leaf = _descend(key, path, pos);
+    size_t i = _leaf_lower(leaf, key);
+    if (i == leaf->count || _cmp(key, leaf->key(i))) {
+      throw std::out_of_range("Key not found");
+    }
+    _erase_at(path, pos, leaf, i);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_erase_at(Inner **path, size_t *pos, Leaf *leaf, size_t i) {
+    leaf->at(i)->~ValueType();
+    _close_gap(leaf->at(0), i, leaf->count);
+    leaf->count--;
+    _size--;
+    if (_depth > 0 && leaf->count < LEAF_MIN) {
+      _rebalance_leaf(path, pos, _depth);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_rebalance_leaf(Inner **path, size_t *pos, int depth) {
+    // Pair up with the left sibling, or the right one for a first child.
+    // Every inner node below the root has a key, so there's always one.
+    Inner *parent = path[depth - 1];
+    size_t s = pos[depth - 1] > 0 ? pos[depth - 1] - 1 : 0;
+    Leaf *left = static_cast<Leaf *>(parent->child[s]);
+    Leaf *right = static_cast<Leaf *>(parent->child[s + 1]);
+
+    if (left->count + right->count <= LEAF_SLOTS) {
+      _unsplit_leaf(left, right);
+      _remove_child(path, pos, depth - 1, s);
+      return;
+    }
+
+    // Too many for one leaf, so even them out
+    size_t total = left->count + right->count;
+    size_t want = total / 2;
+    if (left->count > want) {
+      size_t k = left->count - want;
+      _open_gap_by(right->at(0), k, right->count);
+      for (size_t j = 0; j < k; j++) {
+        _move_slot(right->at(j), left->at(want + j));
+      }
+    } else {
+      size_t k = want - left->count;
+      for (size_t j = 0; j < k; j++) {
+        _move_slot(left->at(left->count + j), right->at(j));
+      }
+      for (size_t j = k; j < right->count; j++) {
+        _move_slot(right->at(j - k), right->at(j));
+      }
+    }
+    left->count = want;
+    right->count = total - want;
+
+    StoredKey sep(right->key(0));
+    parent->key(s)->~StoredKey();
+    new (parent->key(s)) StoredKey(std::move(sep));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_remove_child(Inner **path, size_t *pos, int depth, size_t s) {
+    Inner *in = path[depth];
+    in->key(s)->~StoredKey();
+    _close_gap(in->key(0), s, in->count);
+    for (size_t j = s + 1; j < in->count; j++) {
+      in->child[j] = in->child[j + 1];
+    }
+    in->count--;
+
+    if (depth == 0) {
+      // Root down to one child, the tree loses a level
+      if (in->count == 0) {
+        _root = in->child[0];
+        delete in;
+        _depth--;
+      }
+    } else if (in->count < INNER_MIN) {
+      _rebalance_inner(path, pos, depth);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_rebalance_inner(Inner **path, size_t *pos, int depth) {
+    Inner *parent = path[depth - 1];
+    size_t s = pos[depth - 1] > 0 ? pos[depth - 1] - 1 : 0;
+    Inner *left = static_cast<Inner *>(parent->child[s]);
+    Inner *right = static_cast<Inner *>(parent->child[s + 1]);
+
+    if (left->count + 1 + right->count <= INNER_SLOTS) {
+      // The separator comes down between them
+      size_t n = left->count;
+      new (left->key(n)) StoredKey(*parent->key(s));
+      left->child[n + 1] = right->child[0];
+      for (size_t j = 0; j < right->count; j++) {
+        _move_slot(left->key(n + 1 + j), right->key(j));
+        left->child[n + 2 + j] = right->child[j + 1];
+      }
+      left->count = n + 1 + right->count;
+      delete right;
+      _remove_child(path, pos, depth - 1, s);
+      return;
+    }
+
+    // Otherwise borrow one through the parent from whichever side is short
+    if (right == path[depth]) {
+      _open_gap(right->key(0), 0, right->count);
+      _move_slot(right->key(0), parent->key(s));
+      for (size_t j = right->count + 1; j > 0; j--) {
+        right->child[j] = right->child[j - 1];
+      }
+      right->child[0] = left->child[left->count];
+      _move_slot(parent->key(s), left->key(left->count - 1));
+      left->count--;
+      right->count++;
+    } else {
+      _move_slot(left->key(left->count), parent->key(s));
+      left->child[left->count + 1] = right->child[0];
+      _move_slot(parent->key(s), right->key(0));
+      _close_gap(right->key(0), 0, right->count);
+      for (size_t j = 0; j < right->count; j++) {
+        right->child[j] = right->child[j + 1];
+      }
+      left->count++;
+      right->count--;
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::clear() {
+    _free(_root);
+    _first = _last = _new_leaf();
+    _root = _first;
+    _depth = 0;
+    _size = 0;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Leaf *BPlusMap<Key_T, Mapped_T>::_new_leaf() {
+    Leaf *leaf = new Leaf;
+    leaf->leaf = true;
+    leaf->count = 0;
+    leaf->prev = nullptr;
+    leaf->next = nullptr;
+    return leaf;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Inner *BPlusMap<Key_T, Mapped_T>::_new_inner() {
+    Inner *in = new Inner;
+    in->leaf = false;
+    in->count = 0;
+    return in;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename BPlusMap<Key_T, Mapped_T>::Node *BPlusMap<Key_T, Mapped_T>::_clone(const Node *n, Leaf *& last) {
+    if (n->leaf) {
+      const Leaf *src = static_cast<const Leaf *>(n);
+      Leaf *leaf = _new_leaf();
+      for (; leaf->count < src->count; leaf->count++) {
+        new (leaf->at(leaf->count)) ValueType(*src->at(leaf->count));
+      }
+      leaf->prev = last;
+      if (last != nullptr) {
+        last->next = leaf;
+      }
+      last = leaf;
+      return leaf;
+    }
+
+    const Inner *src = static_cast<const Inner *>(n);
+    Inner *in = _new_inner();
+    for (size_t i = 0; i < src->count; i++) {
+      new (in->key(i)) StoredKey(*src->key(i));
+      in->child[i] = _clone(src->child[i], last);
+    }
+    in->child[src->count] = _clone(src->child[src->count], last);
+    in->count = src->count;
+    return in;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_free(Node *n) {
+    if (n->leaf) {
+      Leaf *leaf = static_cast<Leaf *>(n);
+      for (size_t i = 0; i < leaf->count; i++) {
+        leaf->at(i)->~ValueType();
+      }
+      delete leaf;
+      return;
+    }
+
+    Inner *in = static_cast<Inner *>(n);
+    for (size_t i = 0; i < in->count; i++) {
+      in->key(i)->~StoredKey();
+      _free(in->child[i]);
+    }
+    _free(in->child[in->count]);
+    delete in;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void BPlusMap<Key_T, Mapped_T>::_swap(BPlusMap& other) {
+    std::swap(_cmp, other._cmp);
+    std::swap(_root, other._root);
+    std::swap(_depth, other._depth);
+    std::swap(_first, other._first);
+    std::swap(_last, other._last);
+    std::swap(_size, other._size);
+  }
+}
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+// Small benchmark harness for the cs540 containers. Each case gets its own
+// untimed setup, is run a few times to warm up and then timed for a number
+// of repetitions on the steady clock, and is reported as min, median and p99
+// over the timed runs. Results come out as a text table, JSON or CSV, and
+// two saved result files can be compared to flag regressions.
+//
+// Pinning to a CPU needs Linux, everywhere else it's a no-op with a warning.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace cs540 {
+  namespace bench {
+    enum class Format { TEXT, JSON, CSV };
+
+    struct Options {
+      int warmup = 1;
+      int reps = 5;
+      // -1 leaves scheduling alone
+      int cpu = -1;
+      // Cases with a bigger n get skipped, 0 runs everything
+      size_t max_n = 0;
+      // Only cases whose name contains this run
+      std::string filter;
+      Format format = Format::TEXT;
+      // Empty means stdout
+      std::string out;
+      // Compare mode, baseline and current result files
+      std::string compare_base;
+      std::string compare_current;
+      // Median slowdown past this fraction counts as a regression
+      double threshold = 0.05;
+    };
+
+    struct Result {
+      std::string name;
+      std::string subject;
+      size_t n;
+      std::vector<double> samples_ms;
+      double min_ms;
+      double median_ms;
+      double p99_ms;
+      double mean_ms;
+    };
+
+    // Keeps the compiler from throwing away a value nobody reads
+    template <typename T>
+    inline void do_not_optimize(const T& value) {
+      asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Nearest rank percentile of sorted samples, q in [0, 1]
+    inline double percentile(const std::vector<double>& sorted, double q) {
+      if (sorted.empty()) {
+        return 0;
+      }
+      size_t rank = static_cast<size_t>(q * sorted.size() + 0.999999);
+      return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    inline bool pin_to_cpu(int cpu) {
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+      (void)cpu;
+      return false;
+#endif
+    }
+
+    // --warmup N --reps N --cpu N --max-n N --filter S --format text|json|csv
+    // --out FILE --compare BASE CURRENT --threshold F
+    inline Options parse_args(int argc, char *argv[]) {
+      Options opts;
+      auto need = [&](int& i, int count) {
+        if (i + count >= argc) {
+          throw std::invalid_argument(std::string("missing value for ") + argv[i]);
+        }
+        i++;
+        return argv[i];
+      };
+      for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--warmup") {
+          opts.warmup = std::max(0, std::atoi(need(i, 1)));
+        } else if (arg == "--reps") {
+          opts.reps = std::max(1, std::atoi(need(i, 1)));
+        } else if (arg == "--cpu") {
+          opts.cpu = std::atoi(need(i, 1));
+        } else if (arg == "--max-n") {
+          opts.max_n = std::strtoull(need(i, 1), nullptr, 10);
+        } else if (arg == "--filter") {
+          opts.filter = need(i, 1);
+        } else if (arg == "--format") {
+          std::string f = need(i, 1);
+          if (f == "json") {
+            opts.format = Format::JSON;
+          } else if (f == "csv") {
+            opts.format = Format::CSV;
+          } else if (f == "text") {
+            opts.format = Format::TEXT;
+          } else {
+            throw std::invalid_argument("unknown format " + f);
+          }
+        } else if (arg == "--out") {
+          opts.out = need(i, 1);
+        } else if (arg == "--compare") {
+          opts.compare_base = need(i, 2);
+          opts.compare_current = need(i, 1);
+        } else if (arg == "--threshold") {
+          opts.threshold = std::atof(need(i, 1));
+        } else {
+          throw std::invalid_argument("unknown option " + arg);
+        }
+      }
+      return opts;
+    }
+
+    class Harness {
+    public:
+      explicit Harness(const Options&);
+
+      // Runs setup untimed before every repetition and times body on what it
+      // returned, so each repetition gets fresh state to chew on
+      template <typename Setup, typename Body>
+      void run(const std::string& name, const std::string& subject, size_t n, Setup setup, Body body);
+      // Same thing when there's nothing to set up
+      template <typename Body>
+      void run_plain(const std::string& name, const std::string& subject, size_t n, Body body);
+
+      bool wanted(const std::string& name, size_t n) const;
+      const std::vector<Result>& results() const { return _results; }
+      // Writes everything in the chosen format to the chosen place
+      void report() const;
+      void write(std::ostream&, Format) const;
+
+    private:
+      void _add(const std::string& name, const std::string& subject, size_t n, std::vector<double>& samples);
+
+      Options _opts;
+      std::vector<Result> _results;
+    };
+
+    inline Harness::Harness(const Options& opts): _opts(opts) {
+      // Every case needs at least one sample to report on
+      _opts.warmup = std::max(0, _opts.warmup);
+      _opts.reps = std::max(1, _opts.reps);
+      if (_opts.cpu >= 0 && !pin_to_cpu(_opts.cpu)) {
+        std::cerr << "warning: couldn't pin to cpu " << _opts.cpu << ", running unpinned\n";
+      }
+    }
+
+    inline bool Harness::wanted(const std::string& name, size_t n) const {
+      return (_opts.max_n == 0 || n <= _opts.max_n) &&
+        (_opts.filter.empty() || name.find(_opts.filter) != std::string::npos);
+    }
+
+    template <typename Setup, typename Body>
+    void Harness::run(const std::string& name, const std::string& subject, size_t n, Setup setup, Body body) {
+      if (!wanted(name, n)) {
+        return;
+      }
+      std::vector<double> samples;
+      for (int r = 0; r < _opts.warmup + _opts.reps; r++) {
+        auto state = setup();
+        auto start = std::chrono::steady_clock::now();
+        body(state);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (r >= _opts.warmup) {
+          samples.push_back(elapsed.count());
+        }
+      }
+      _add(name, subject, n, samples);
+    }
+
+    template <typename Body>
+    void Harness::run_plain(const std::string& name, const std::string& subject, size_t n, Body body) {
+      run(name, subject, n, []() { return 0; }, [&](int) { body(); });
+    }
+
+    inline void Harness::_add(const std::string& name, const std::string& subject, size_t n, std::vector<double>& samples) {
+      Result res;
+      res.name = name;
+      res.subject = subject;
+      res.n = n;
+      res.samples_ms = samples;
+      std::sort(samples.begin(), samples.end());
+      res.min_ms = samples.front();
+      res.median_ms = samples.size() % 2 == 1 ? samples[samples.size() / 2] :
+        (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2;
+      res.p99_ms = percentile(samples, 0.99);
+      double sum = 0;
+      for (double s: samples) {
+        sum += s;
+      }
+      res.mean_ms = sum / samples.size();
+      _results.push_back(res);
+
+      // Progress goes to stderr so stdout stays clean for JSON and CSV
+      std::cerr << name << " / " << subject << " / " << n << ": median " << res.median_ms << " ms\n";
+    }
+
+    inline void Harness::report() const {
+      if (_opts.out.empty()) {
+        write(std::cout, _opts.format);
+        return;
+      }
+      std::ofstream out(_opts.out);
+      if (!out) {
+        throw std::runtime_error("can't write " + _opts.out);
+      }
+      write(out, _opts.format);
+    }
+
+    inline std::string json_escape(const std::string& s) {
+      std::string r;
+      for (char c: s) {
+        if (c == '"' || c == '\\') {
+          r += '\\';
+        }
+        r += c;
+      }
+      return r;
+    }
+
+    inline std::string csv_field(const std::string& s) {
+      if (s.find_first_of(",\"") == std::string::npos) {
+        return s;
+      }
+      std::string r = "\"";
+      for (char c: s) {
+        if (c == '"') {
+          r += '"';
+        }
+        r += c;
+      }
+      return r + "\"";
+    }
+
+    inline void Harness::write(std::ostream& os, Format format) const {
+      std::ostringstream body;
+      body << std::setprecision(6);
+      if (format == Format::JSON) {
+        // One result per line, which is also what read_results counts on
+        body << "[\n";
+        for (size_t i = 0; i < _results.size(); i++) {
+          const Result& r = _results[i];
+          body << "  {\"name\": \"" << json_escape(r.name) << "\", \"subject\": \"" << json_escape(r.subject)
+               << "\", \"n\": " << r.n << ", \"reps\": " << r.samples_ms.size() << ", \"min_ms\": " << r.min_ms
+               << ", \"median_ms\": " << r.median_ms << ", \"p99_ms\": " << r.p99_ms << ", \"mean_ms\": "
+               << r.mean_ms << ", \"samples_ms\": [";
+          for (size_t j = 0; j < r.samples_ms.size(); j++) {
+            body << (j ? ", " : "") << r.samples_ms[j];
+          }
+          body << "]}" << (i + 1 < _results.size() ? "," : "") << "\n";
+        }
+        body << "]\n";
+      } else if (format == Format::CSV) {
+        body << "name,subject,n,reps,min_ms,median_ms,p99_ms,mean_ms\n";
+        for (const Result& r: _results) {
+          body << csv_field(r.name) << "," << csv_field(r.subject) << "," << r.n << "," << r.samples_ms.size() << ","
+               << r.min_ms << "," << r.median_ms << "," << r.p99_ms << "," << r.mean_ms << "\n";
+        }
+      } else {
+        body << std::left << std::setw(24) << "case" << std::setw(40) << "subject" << std::right << std::setw(12)
+             << "n" << std::setw(12) << "min ms" << std::setw(12) << "median ms" << std::setw(12) << "p99 ms"
+             << "\n";
+        for (const Result& r: _results) {
+          body << std::left << std::setw(24) << r.name << std::setw(40) << r.subject << std::right << std::setw(12)
+               << r.n << std::setw(12) << r.min_ms << std::setw(12) << r.median_ms << std::setw(12) << r.p99_ms
+               << "\n";
+        }
+      }
+      os << body.str();
+    }
+
+    // Reads back what write() put out as JSON or CSV, by the file's first
+    // character. Only the summary numbers come back, not the samples.
+    inline std::vector<Result> read_results(const std::string& path) {
+      std::ifstream in(path);
+      if (!in) {
+        throw std::runtime_error("can't read " + path);
+      }
+      std::vector<Result> results;
+      std::string line;
+      bool json = in.peek() == '[';
+      bool header = true;
+      while (std::getline(in, line)) {
+        Result r;
+        if (json) {
+          if (line.find("\"name\"") == std::string::npos) {
+            continue;
+          }
+          auto str = [&](const char *key) {
+            size_t p = line.find(std::string("\"") + key + "\": \"");
+            if (p == std::string::npos) {
+              throw std::runtime_error("bad result line in " + path);
+            }
+            std::string v;
+            for (p += std::strlen(key) + 5; p < line.size() && line[p] != '"'; p++) {
+              if (line[p] == '\\') {
+                p++;
+              }
+              v += line[p];
+            }
+            return v;
+          };
+          auto num = [&](const char *key) {
+            size_t p = line.find(std::string("\"") + key + "\": ");
+            if (p == std::string::npos) {
+              throw std::runtime_error("bad result line in " + path);
+            }
+            return std::atof(line.c_str() + p + std::strlen(key) + 4);
+          };
+          r.name = str("name");
+          r.subject = str("subject");
+          r.n = static_cast<size_t>(num("n"));
+          r.min_ms = num("min_ms");
+          r.median_ms = num("median_ms");
+          r.p99_ms = num("p99_ms");
+          r.mean_ms = num("mean_ms");
+        } else {
+          if (header) {
+            header = false;
+            continue;
+          }
+          if (line.empty()) {
+            continue;
+          }
+          // Quoted fields can hold commas and doubled quotes
+          std::vector<std::string> fields(1);
+          bool quoted = false;
+          for (size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            if (quoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+              fields.back() += '"';
+              i++;
+            } else if (c == '"') {
+              quoted = !quoted;
+            } else if (c == ',' && !quoted) {
+              fields.emplace_back();
+            } else {
+              fields.back() += c;
+            }
+          }
+          if (fields.size() != 8) {
+            throw std::runtime_error("bad result line in " + path);
+          }
+          r.name = fields[0];
+          r.subject = fields[1];
+          r.n = std::strtoull(fields[2].c_str(), nullptr, 10);
+          r.min_ms = std::atof(fields[4].c_str());
+          r.median_ms = std::atof(fields[5].c_str());
+          r.p99_ms = std::atof(fields[6].c_str());
+          r.mean_ms = std::atof(fields[7].c_str());
+        }
+        results.push_back(r);
+      }
+      return results;
+    }
+
+    // Lines up cases by name, subject and n and prints the change in median.
+    // A regression is a median slower by more than threshold where even the
+    // fastest new run is slower than the baseline's p99, so runs that only
+    // drifted inside the noise don't count. The count of regressions comes
+    // back so it can be the exit status.
+    inline int compare(const std::string& base_path, const std::string& current_path, double threshold, std::ostream& os) {
+      std::map<std::string, Result> base;
+      auto key = [](const Result& r) {
+        return r.name + "\n" + r.subject + "\n" + std::to_string(r.n);
+      };
+      for (const Result& r: read_results(base_path)) {
+        base[key(r)] = r;
+      }
+
+      int regressions = 0;
+      os << std::left << std::setw(24) << "case" << std::setw(40) << "subject" << std::right << std::setw(12) << "n"
+         << std::setw(14) << "base median" << std::setw(14) << "new median" << std::setw(10) << "change" << "\n";
+      os << std::fixed << std::setprecision(3);
+      for (const Result& r: read_results(current_path)) {
+        auto it = base.find(key(r));
+        if (it == base.end()) {
+          continue;
+        }
+        double change = it->second.median_ms > 0 ? r.median_ms / it->second.median_ms - 1 : 0;
+        const char *verdict = "";
+        if (change > threshold && r.min_ms > it->second.p99_ms) {
+          verdict = "  REGRESSION";
+          regressions++;
+        } else if (change > threshold) {
+          verdict = "  slower, within noise";
+        } else if (change < -threshold && r.p99_ms < it->second.min_ms) {
+          verdict = "  faster";
+        }
+        os << std::left << std::setw(24) << r.name << std::setw(40) << r.subject << std::right << std::setw(12) << r.n
+           << std::setw(14) << it->second.median_ms << std::setw(14) << r.median_ms << std::setw(9)
+           << std::setprecision(1) << change * 100 << "%" << std::setprecision(3) << verdict << "\n";
+      }
+      os << regressions << " regression" << (regressions == 1 ? "" : "s") << " past " << threshold * 100 << "%\n";
+      return regressions;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,561 @@
+#ifndef _CONCURRENT_MAP_H_
+#define _CONCURRENT_MAP_H_
+
+// Needs -pthread
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Map.hpp"
+
+namespace cs540 {
+  // Epoch based reclamation. Threads pin the current epoch while they might be
+  // holding pointers into a shared structure, and anything retired in epoch e
+  // is only freed once the global epoch reaches e + 2, by which point nobody
+  // pinned at e or earlier can still be around.
+  class EpochDomain {
+  public:
+    static EpochDomain& instance() {
+      static EpochDomain domain;
+      return domain;
+    }
+
+    void enter();
+    void exit();
+    // p has to already be unreachable for threads that pin after this call
+    void retire(void *p, void (*deleter)(void *));
+
+  private:
+    static const size_t SCAN_EVERY = 64;
+
+    struct Record {
+      // (epoch << 1) | 1 while pinned, 0 otherwise
+      std::atomic<uint64_t> state;
+      std::atomic<bool> in_use;
+      Record *next;
+    };
+
+    struct Retired {
+      void *p;
+      void (*deleter)(void *);
+      uint64_t epoch;
+    };
+
+    // Per thread bookkeeping, hands its leftovers to the domain on thread exit
+    struct ThreadState {
+      explicit ThreadState(EpochDomain& d): domain(d), rec(d._acquire_record()), depth(0), since_scan(0) {}
+      ~ThreadState() {
+        domain._orphan(retired);
+        rec->state.store(0);
+        rec->in_use.store(false);
+      }
+      EpochDomain& domain;
+      Record *rec;
+      int depth;
+      size_t since_scan;
+      std::vector<Retired> retired;
+    };
+
+    EpochDomain(): _epoch(2), _records(nullptr) {}
+    // Only runs at exit, once every other thread is gone
+    ~EpochDomain() {
+      for (size_t i = 0; i < _orphans.size(); i++) {
+        _orphans[i].deleter(_orphans[i].p);
+      }
+      for (Record *r = _records.load(); r;) {
+        Record *t = r->next;
+        delete r;
+        r = t;
+      }
+    }
+
+    ThreadState& _local() {
+      static thread_local ThreadState state(*this);
+      return state;
+    }
+    Record *_acquire_record();
+    bool _try_advance();
+    void _scan(std::vector<Retired>&);
+    void _orphan(std::vector<Retired>&);
+
+    std::atomic<uint64_t> _epoch;
+    std::atomic<Record *> _records;
+    std::mutex _orphans_lock;
+    std::vector<Retired> _orphans;
+  };
+
+  inline EpochDomain::Record *EpochDomain::_acquire_record() {
+    // Reuse one a dead thread left behind if we can
+    for (Record *r = _records.load(); r; r = r->next) {
+      bool expected = false;
+      if (!r->in_use.load() && r->in_use.compare_exchange_strong(expected, true)) {
+        return r;
+      }
+    }
+    Record *r = new Record;
+    r->state.store(0);
+    r->in_use.store(true);
+    r->next = _records.load();
+    while (!_records.compare_exchange_weak(r->next, r)) {}
+    return r;
+  }
+
+  inline void EpochDomain::enter() {
+    ThreadState& ts = _local();
+    if (ts.depth++ > 0) return;
+    ts.rec->state.store((_epoch.load() << 1) | 1);
+  }
+
+  inline void EpochDomain::exit() {
+    ThreadState& ts = _local();
+    if (--ts.depth > 0) return;
+    ts.rec->state.store(0, std::memory_order_release);
+  }
+
+  inline bool EpochDomain::_try_advance() {
+    uint64_t e = _epoch.load();
+    for (Record *r = _records.load(); r; r = r->next) {
+      uint64_t s = r->state.load();
+      if ((s & 1) && (s >> 1) != e) {
+        return false;
+      }
+    }
+    return _epoch.compare_exchange_strong(e, e + 1);
+  }
+
+  inline void EpochDomain::_scan(std::vector<Retired>& list) {
+    uint64_t e = _epoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+      if (list[i].epoch + 2 <= e) {
+        list[i].deleter(list[i].p);
+      } else {
+        list[kept++] = list[i];
+      }
+    }
+    list.resize(kept);
+  }
+
+  inline void EpochDomain::retire(void *p, void (*deleter)(void *)) {
+    ThreadState& ts = _local();
+    Retired r = {p, deleter, _epoch.load()};
+    ts.retired.push_back(r);
+    if (++ts.since_scan >= SCAN_EVERY) {
+      ts.since_scan = 0;
+      _try_advance();
+      _scan(ts.retired);
+      std::unique_lock<std::mutex> g(_orphans_lock, std::try_to_lock);
+      if (g.owns_lock() && !_orphans.empty()) {
+        _scan(_orphans);
+      }
+    }
+  }
+
+  inline void EpochDomain::_orphan(std::vector<Retired>& list) {
+    std::lock_guard<std::mutex> g(_orphans_lock);
+    _orphans.insert(_orphans.end(), list.begin(), list.end());
+    list.clear();
+  }
+
+  // Pins the epoch for as long as it lives, nests fine within one thread
+  class EpochGuard {
+  public:
+    EpochGuard() { EpochDomain::instance().enter(); }
+    EpochGuard(const EpochGuard&) { EpochDomain::instance().enter(); }
+    EpochGuard& operator=(const EpochGuard&) { return *this; }
+    ~EpochGuard() { EpochDomain::instance().exit(); }
+  };
+
+  // Lock free skip list (Herlihy and Shavit's, with the mark bit in the low
+  // bit of each next pointer). insert links level 0 first and that CAS is the
+  // linearization point; erase marks the tower top down and whoever marks
+  // level 0 owns the removal. Anyone who walks past a marked node snips it.
+  template <typename Key_T, typename Mapped_T>
+  class ConcurrentMap {
+  public:
+    using ValueType = std::pair<const Key_T, Mapped_T>;
+
+    ConcurrentMap();
+    ConcurrentMap(std::initializer_list<ValueType>);
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+    // No other thread can be using the map by now
+    ~ConcurrentMap();
+
+    // Size, only exact when nothing else is going on
+    size_t size() const { return _size.load(); }
+    bool empty() const { return size() == 0; }
+
+    // Iterators pin the epoch, so don't hang on to them forever and don't
+    // hand them to another thread. They skip anything erased under them.
+    class Iterator;
+    using ConstIterator = Iterator;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    // Element access
+    Iterator find(const Key_T&) const;
+    // A copy, since a reference would outlive the epoch pin and dangle as
+    // soon as another thread erased the key. Hold on to the Iterator from
+    // find to work on the value in place.
+    Mapped_T at(const Key_T&) const;
+
+    // Modifiers
+    std::pair<Iterator, bool> insert(const ValueType&);
+    template <typename IT_T>
+    void insert(IT_T range_beg, IT_T range_end);
+    void erase(Iterator pos);
+    void erase(const Key_T&);
+    // Same as erase but says whether it did anything instead of throwing
+    bool remove(const Key_T&);
+
+  private:
+    struct Node {
+      Node() = default;
+      Node(const Node&) = delete;
+      Node& operator=(const Node&) = delete;
+
+      static constexpr size_t value_offset =
+        (sizeof(ValueType) + alignof(Node *) - 1) / alignof(Node *) * alignof(Node *);
+
+      static size_t bytes(int height) {
+        return sizeof(Node) + (height - 1) * sizeof(std::atomic<uintptr_t>);
+      }
+
+      ValueType *data() {
+        return reinterpret_cast<ValueType *>(reinterpret_cast<char *>(this) - value_offset);
+      }
+
+      // Inserter and remover both have to be done with a node before it
+      // can be retired, whoever finishes last does it
+      std::atomic<int> owners;
+      int height;
+      std::atomic<uintptr_t> next[1]; // Really height long
+    };
+
+    static Node *_ptr(uintptr_t p) { return reinterpret_cast<Node *>(p & ~uintptr_t(1)); }
+    static bool _marked(uintptr_t p) { return p & 1; }
+    static uintptr_t _raw(Node *n) { return reinterpret_cast<uintptr_t>(n); }
+
+    static Node *_new_node(int height, const ValueType&);
+    static void _free_node(void *);
+    void _release(Node *);
+    bool _find(const Key_T&, Node **preds, Node **succs) const;
+
+    Node *_head;
+    std::atomic<int> _height; // Tallest tower so far, searches start here
+    std::atomic<size_t> _size;
+
+  public:
+    class Iterator {
+    public:
+      Iterator() = delete;
+      Iterator(const Iterator&) = default;
+      Iterator& operator=(const Iterator&) = default;
+      ~Iterator() = default;
+
+      Iterator& operator++() {
+        _it = _ptr(_it->next[0].load(std::memory_order_acquire));
+        while (_it && _marked(_it->next[0].load(std::memory_order_acquire))) {
+          _it = _ptr(_it->next[0].load(std::memory_order_acquire));
+        }
+        return *this;
+      }
+      Iterator operator++(int) {
+        Iterator t(*this);
+        ++(*this);
+        return t;
+      }
+      ValueType& operator*() const {
+        return *(_it->data());
+      }
+      ValueType *operator->() const {
+        return _it->data();
+      }
+      friend bool operator==(const Iterator& i1, const Iterator& i2) {
+        return i1._it == i2._it;
+      }
+      friend bool operator!=(const Iterator& i1, const Iterator& i2) {
+        return !(i1 == i2);
+      }
+
+    private:
+      friend class ConcurrentMap;
+      explicit Iterator(Node *it): _it(it) {}
+      EpochGuard _guard;
+      Node *_it;
+    };
+  };
+
+  template <typename Key_T, typename Mapped_T>
+  typename ConcurrentMap<Key_T, Mapped_T>::Node *ConcurrentMap<Key_T, Mapped_T>::_new_node(int height, const ValueType& val) {
+    char *mem = static_cast<char *>(::operator new(Node::value_offset + Node::bytes(height)));
+    try {
+      new (mem) ValueType(val);
+    } catch (...) {
+      ::operator delete(mem);
+      throw;
+    }
+    Node *n = new (mem + Node::value_offset) Node;
+    n->owners.store(2, std::memory_order_relaxed);
+    n->height = height;
+    for (int i = 0; i < height; i++) {
+      new (&n->next[i]) std::atomic<uintptr_t>(0);
+    }
+    return n;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void ConcurrentMap<Key_T, Mapped_T>::_free_node(void *p) {
+    Node *n = static_cast<Node *>(p);
+    ValueType *val = n->data();
+    val->~ValueType();
+    ::operator delete(static_cast<void *>(val));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void ConcurrentMap<Key_T, Mapped_T>::_release(Node *n) {
+    if (n->owners.fetch_sub(1) == 1) {
+      EpochDomain::instance().retire(n, &_free_node);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  ConcurrentMap<Key_T, Mapped_T>::ConcurrentMap():
+    _head(nullptr),
+    _height(1),
+    _size(0) {
+    _head = new (::operator new(Node::bytes(MAX_SKIP_LIST_HEIGHT))) Node;
+    _head->height = MAX_SKIP_LIST_HEIGHT;
+    for (int i = 0; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      new (&_head->next[i]) std::atomic<uintptr_t>(0);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  ConcurrentMap<Key_T, Mapped_T>::ConcurrentMap(std::initializer_list<ValueType> init_list):
+    ConcurrentMap() {
+    insert(init_list.begin(), init_list.end());
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  ConcurrentMap<Key_T, Mapped_T>::~ConcurrentMap() {
+    // Everything erased is already unlinked and belongs to the epoch domain
+    Node *it = _ptr(_head->next[0].load());
+    while (it) {
+      Node *t = _ptr(it->next[0].load());
+      _free_node(it);
+      it = t;
+    }
+    ::operator delete(static_cast<void *>(_head));
+  }
+
+  // Fills in the predecessor and successor of key on every level below the
+  // current height, snipping out marked nodes on the way down
+  template <typename Key_T, typename Mapped_T>
+  bool ConcurrentMap<Key_T, Mapped_T>::_find(const Key_T& key, Node **preds, Node **succs) const {
+  retry:
+    int height = _height.load(std::memory_order_acquire);
+    Node *pred = _head;
+    for (int level = MAX_SKIP_LIST_HEIGHT - 1; level >= height; level--) {
+      preds[level] = _head;
+      succs[level] = nullptr;
+    }
+    for (int level = height - 1; level >= 0; level--) {
+      Node *curr = _ptr(pred->next[level].load(std::memory_order_acquire));
+      while (curr) {
+        uintptr_t succ = curr->next[level].load(std::memory_order_acquire);
+        if (_marked(succ)) {
+          // curr is on its way out, help it along
+          uintptr_t expected = _raw(curr);
+          if (!pred->next[level].compare_exchange_strong(expected, succ & ~uintptr_t(1))) {
+            goto retry;
+          }
+          curr = _ptr(succ);
+          continue;
+        }
+        if (!(curr->data()->first < key)) {
+          break;
+        }
+        pred = curr;
+        curr = _ptr(succ);
+      }
+      preds[level] = pred;
+      succs[level] = curr;
+    }
+    return succs[0] && succs[0]->data()->first == key;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename ConcurrentMap<Key_T, Mapped_T>::Iterator ConcurrentMap<Key_T, Mapped_T>::begin() const {
+    Iterator it(_head);
+    return ++it;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename ConcurrentMap<Key_T, Mapped_T>::Iterator ConcurrentMap<Key_T, Mapped_T>::end() const {
+    return Iterator(nullptr);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename ConcurrentMap<Key_T, Mapped_T>::Iterator ConcurrentMap<Key_T, Mapped_T>::find(const Key_T& key) const {
+    // Read only walk, no helping, so find never writes to shared memory
+    Iterator res(nullptr);
+    Node *pred = _head;
+    Node *curr = nullptr;
+    for (int level = _height.load(std::memory_order_acquire) - 1; level >= 0; level--) {
+      curr = _ptr(pred->next[level].load(std::memory_order_acquire));
+      while (curr) {
+        uintptr_t succ = curr->next[level].load(std::memory_order_acquire);
+        if (_marked(succ)) {
+          curr = _ptr(succ);
+          continue;
+        }
+        if (!(curr->data()->first < key)) {
+          break;
+        }
+        pred = curr;
+        curr = _ptr(succ);
+      }
+    }
+    if (curr && curr->data()->first == key) {
+      res._it = curr;
+    }
+    return res;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Mapped_T ConcurrentMap<Key_T, Mapped_T>::at(const Key_T& key) const {
+    // The copy is made before it, and with it the pin, goes away
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Key not found");
+    }
+    return it->second;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename ConcurrentMap<Key_T, Mapped_T>::Iterator, bool> ConcurrentMap<Key_T, Mapped_T>::insert(const ValueType& val) {
+    static thread_local SkipLevelGenerator levels;
+    Iterator res(nullptr);
+    Node *preds[MAX_SKIP_LIST_HEIGHT];
+    Node *succs[MAX_SKIP_LIST_HEIGHT];
+    Node *sn = nullptr;
+    int sn_height = levels();
+
+    // Raise the height first so searches that start after we link see our tower
+    int height = _height.load();
+    while (sn_height > height && !_height.compare_exchange_weak(height, sn_height)) {}
+
+    for (;;) {
+      if (_find(val.first, preds, succs)) {
+        if (sn) _free_node(sn);
+        res._it = succs[0];
+        return std::make_pair(res, false);
+      }
+      if (!sn) sn = _new_node(sn_height, val);
+      for (int i = 0; i < sn_height; i++) {
+        sn->next[i].store(_raw(succs[i]), std::memory_order_relaxed);
+      }
+      uintptr_t expected = _raw(succs[0]);
+      if (preds[0]->next[0].compare_exchange_strong(expected, _raw(sn))) {
+        break;
+      }
+    }
+    _size++;
+
+    // It's in, the rest of the tower is just an index
+    for (int level = 1; level < sn_height; level++) {
+      for (;;) {
+        uintptr_t nxt = sn->next[level].load();
+        if (_marked(nxt)) {
+          goto linked;
+        }
+        if (nxt != _raw(succs[level]) &&
+            !sn->next[level].compare_exchange_strong(nxt, _raw(succs[level]))) {
+          continue;
+        }
+        uintptr_t expected = _raw(succs[level]);
+        if (preds[level]->next[level].compare_exchange_strong(expected, _raw(sn))) {
+          break;
+        }
+        // Something moved, look again and give up if we've been erased
+        _find(val.first, preds, succs);
+        if (succs[0] != sn) {
+          goto linked;
+        }
+      }
+    }
+  linked:
+    // If an erase raced with the linking above, one of our late links may be
+    // back in the list, so snip again before giving up our claim on sn
+    if (_marked(sn->next[0].load())) {
+      _find(val.first, preds, succs);
+    }
+    res._it = sn;
+    _release(sn);
+    return std::make_pair(res, true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename IT_T>
+  void ConcurrentMap<Key_T, Mapped_T>::insert(IT_T range_beg, IT_T range_end) {
+    for (auto it = range_beg; it != range_end; it++) {
+      insert(*it);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  bool ConcurrentMap<Key_T, Mapped_T>::remove(const Key_T& key) {
+    EpochGuard guard;
+    Node *preds[MAX_SKIP_LIST_HEIGHT];
+    Node *succs[MAX_SKIP_LIST_HEIGHT];
+    if (!_find(key, preds, succs)) {
+      return false;
+    }
+
+    Node *victim = succs[0];
+    for (int level = victim->height - 1; level > 0; level--) {
+      uintptr_t nxt = victim->next[level].load();
+      while (!_marked(nxt) && !victim->next[level].compare_exchange_weak(nxt, nxt | 1)) {}
+    }
+
+    // Marking level 0 is the linearization point, only one thread gets it
+    uintptr_t nxt = victim->next[0].load();
+    for (;;) {
+      if (_marked(nxt)) {
+        return false;
+      }
+      if (victim->next[0].compare_exchange_strong(nxt, nxt | 1)) {
+        break;
+      }
+    }
+    _size--;
+
+    _find(key, preds, succs);
+    _release(victim);
+    return true;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void ConcurrentMap<Key_T, Mapped_T>::erase(Iterator pos) {
+    if (pos == end()) {
+      return;
+    }
+    remove(pos->first);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void ConcurrentMap<Key_T, Mapped_T>::erase(const Key_T& key) {
+    if (!remove(key)) {
+      throw std::out_of_range("Key not found");
+    }
+  }
+}
+
+#endif /* _CONCURRENT_MAP_H_ */
@@ -0,0 +1,486 @@
+#ifndef _FROZEN_MAP_H_
+#define _FROZEN_MAP_H_
+
+// POSIX only, it needs mmap
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cs540 {
+  // Read only string to string table on disk, laid out like an SSTable:
+  //
+  //   data block *  entries in key order, about BLOCK_BYTES each
+  //   index block   last key, offset and size of every data block
+  //   footer        where the index is, entry and block counts, magic
+  //
+  // Each entry is stored as: varint shared key bytes, varint unshared key
+  // bytes, varint value size, the unshared bytes, then the value. Every
+  // RESTART_INTERVAL entries the shared count goes back to 0, so a restart
+  // holds its whole key. A block ends with the offset of each restart and
+  // then the restart count, 32 bits apiece. All fixed size numbers are little
+  // endian.
+  //
+  // FrozenMap mmaps a table and answers lookups and scans right out of the
+  // mapping. The only thing it builds when it opens is the index, one entry
+  // per block.
+  class FrozenMap {
+  public:
+    static const size_t BLOCK_BYTES = 4096;
+    static const int RESTART_INTERVAL = 16;
+    static const uint64_t MAGIC = 0x70616d3034357363ull; // "cs540map"
+
+    // Bytes somewhere else, usually in the mapping, good for as long as the
+    // FrozenMap is
+    struct Slice {
+      const char *data;
+      size_t size;
+
+      Slice(): data(""), size(0) {}
+      Slice(const char *d, size_t n): data(d), size(n) {}
+      Slice(const char *s): data(s), size(std::strlen(s)) {}
+      Slice(const std::string& s): data(s.data()), size(s.size()) {}
+#if __cplusplus >= 201703L
+      Slice(std::string_view s): data(s.data()), size(s.size()) {}
+      operator std::string_view() const {
+        return std::string_view(data, size);
+      }
+#endif
+
+      std::string str() const {
+        return std::string(data, size);
+      }
+      int compare(const Slice& other) const {
+        int c = std::memcmp(data, other.data, std::min(size, other.size));
+        return c != 0 ? c : (size > other.size) - (size < other.size);
+      }
+      friend bool operator==(const Slice& a, const Slice& b) {
+        return a.size == b.size && std::memcmp(a.data, b.data, a.size) == 0;
+      }
+      friend bool operator!=(const Slice& a, const Slice& b) {
+        return !(a == b);
+      }
+      friend bool operator<(const Slice& a, const Slice& b) {
+        return a.compare(b) < 0;
+      }
+    };
+
+    class ConstIterator;
+
+    explicit FrozenMap(const std::string& path);
+    FrozenMap(const FrozenMap&) = delete;
+    FrozenMap& operator=(const FrozenMap&) = delete;
+    ~FrozenMap();
+
+    // Writes out [range_beg, range_end) of pairs of strings, which has to be
+    // sorted with no repeated keys, a Map's own order
+    template <typename IT_T>
+    static void write(const std::string& path, IT_T range_beg, IT_T range_end);
+    template <typename Map_T>
+    static void write(const std::string& path, const Map_T& map) {
+      write(path, map.begin(), map.end());
+    }
+
+    // Size
+    size_t size() const;
+    bool empty() const;
+
+    // Iterators
+    ConstIterator begin() const;
+    ConstIterator end() const;
+
+    // Element access, anything a Slice can be made from works as a key
+    ConstIterator find(const Slice&) const;
+    Slice at(const Slice&) const;
+    size_t count(const Slice&) const;
+    ConstIterator lower_bound(const Slice&) const;
+    ConstIterator upper_bound(const Slice&) const;
+
+    class ConstIterator {
+    public:
+      // The key gets pieced back together from the prefix compression, the
+      // value points into the mapping
+      const std::string& key() const {
+        return _key;
+      }
+      Slice value() const {
+        return Slice(_value, _value_size);
+      }
+      std::pair<const std::string&, Slice> operator*() const {
+        return std::pair<const std::string&, Slice>(_key, value());
+      }
+
+      ConstIterator& operator++();
+      ConstIterator operator++(int) {
+        ConstIterator it = *this;
+        ++*this;
+        return it;
+      }
+
+      friend bool operator==(const ConstIterator& i1, const ConstIterator& i2) {
+        return i1._block == i2._block && i1._offset == i2._offset;
+      }
+      friend bool operator!=(const ConstIterator& i1, const ConstIterator& i2) {
+        return !(i1 == i2);
+      }
+
+    private:
+      friend class FrozenMap;
+      ConstIterator(const FrozenMap *map, size_t block, size_t offset):
+        _map(map), _block(block), _offset(offset), _next(offset), _value(nullptr), _value_size(0) {}
+
+      // Decodes the entry at _offset on top of the key before it
+      void _decode();
+
+      const FrozenMap *_map;
+      size_t _block;
+      size_t _offset;
+      size_t _next;
+      std::string _key;
+      const char *_value;
+      size_t _value_size;
+    };
+
+  private:
+    struct Block {
+      Slice last_key;
+      const char *data;
+      size_t data_size; // Up to the restart array
+      const char *restarts;
+      uint32_t num_restarts;
+    };
+
+    static void _put_varint(std::string& out, uint64_t v);
+    static void _put_fixed(std::string& out, uint64_t v, int bytes);
+    static const char *_get_varint(const char *p, const char *limit, uint64_t *v);
+    static uint64_t _get_fixed(const char *p, int bytes);
+    // Key of the restart entry, restarts hold their whole key
+    Slice _restart_key(const Block&, uint32_t i) const;
+    void _corrupt() const;
+
+    std::string _path;
+    const char *_base;
+    size_t _length;
+    size_t _size;
+    std::vector<Block> _blocks;
+  };
+
+  inline void FrozenMap::_put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+      out.push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+  }
+
+  inline void FrozenMap::_put_fixed(std::string& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+  }
+
+  inline const char *FrozenMap::_get_varint(const char *p, const char *limit, uint64_t *v) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && p < limit; shift += 7) {
+      uint64_t byte = static_cast<unsigned char>(*p++);
+      result |= (byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        *v = result;
+        return p;
+      }
+    }
+    return nullptr;
+  }
+
+  inline uint64_t FrozenMap::_get_fixed(const char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+      v |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+  }
+
+  template <typename IT_T>
+  void FrozenMap::write(const std::string& path, IT_T range_beg, IT_T range_end) {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Can't open " + path + " for writing");
+    }
+
+    std::string block, index, last_key;
+    std::vector<uint32_t> restarts;
+    int since_restart = 0;
+    uint64_t offset = 0, entries = 0, blocks = 0;
+    auto flush = [&]() {
+      if (block.empty()) {
+        return;
+      }
+      for (uint32_t r: restarts) {
+        _put_fixed(block, r, 4);
+      }
+      _put_fixed(block, restarts.size(), 4);
+      out.write(block.data(), block.size());
+      _put_varint(index, last_key.size());
+      index += last_key;
+      _put_fixed(index, offset, 8);
+      _put_fixed(index, block.size(), 8);
+      offset += block.size();
+      blocks++;
+      block.clear();
+      restarts.clear();
+    };
+
+    for (IT_T it = range_beg; it != range_end; ++it) {
+      const std::string& key = it->first;
+      const std::string& value = it->second;
+      if (entries > 0 && !(last_key < key)) {
+        throw std::invalid_argument("Keys have to be sorted and unique");
+      }
+      size_t shared = 0;
+      if (block.empty() || since_restart == RESTART_INTERVAL) {
+        restarts.push_back(block.size());
+        since_restart = 0;
+      } else {
+        size_t most = std::min(last_key.size(), key.size());
+        while (shared < most && last_key[shared] == key[shared]) {
+          shared++;
+        }
+      }
+      _put_varint(block, shared);
+      _put_varint(block, key.size() - shared);
+      _put_varint(block, value.size());
+      block.append(key, shared, std::string::npos);
+      block += value;
+      since_restart++;
+      last_key = key;
+      entries++;
+      if (block.size() >= BLOCK_BYTES) {
+        flush();
+      }
+    }
+    flush();
+
+    std::string footer;
+    _put_fixed(footer, offset, 8);
+    _put_fixed(footer, index.size(), 8);
+    _put_fixed(footer, entries, 8);
+    _put_fixed(footer, blocks, 8);
+    _put_fixed(footer, MAGIC, 8);
+    out.write(index.data(), index.size());
+    out.write(footer.data(), footer.size());
+    out.close();
+    if (!out) {
+      throw std::runtime_error("Writing " + path + " failed");
+    }
+  }
+
+  inline FrozenMap::FrozenMap(const std::string& path): _path(path), _base(nullptr), _length(0), _size(0) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Can't open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < 40) {
+      ::close(fd);
+      throw std::runtime_error(path + " is too short to be a table");
+    }
+    _length = st.st_size;
+    void *base = ::mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("Can't mmap " + path);
+    }
+    _base = static_cast<const char *>(base);
+
+    try {
+      const char *footer = _base + _length - 40;
+      uint64_t index_offset = _get_fixed(footer, 8);
+      uint64_t index_size = _get_fixed(footer + 8, 8);
+      _size = _get_fixed(footer + 16, 8);
+      uint64_t num_blocks = _get_fixed(footer + 24, 8);
+      if (_get_fixed(footer + 32, 8) != MAGIC || index_offset > _length - 40 ||
+          index_size != _length - 40 - index_offset) {
+        _corrupt();
+      }
+
+      const char *p = _base + index_offset;
+      const char *limit = p + index_size;
+      _blocks.reserve(num_blocks);
+      while (p < limit) {
+        uint64_t key_size;
+        p = _get_varint(p, limit, &key_size);
+        if (p == nullptr || key_size + 16 > uint64_t(limit - p)) {
+          _corrupt();
+        }
+        Block b;
+        b.last_key = Slice(p, key_size);
+        uint64_t offset = _get_fixed(p + key_size, 8);
+        uint64_t size = _get_fixed(p + key_size + 8, 8);
+        p += key_size + 16;
+        if (offset > index_offset || size > index_offset - offset || size < 4) {
+          _corrupt();
+        }
+        b.data = _base + offset;
+        b.num_restarts = _get_fixed(b.data + size - 4, 4);
+        if (b.num_restarts == 0 || (size - 4) / 4 < b.num_restarts) {
+          _corrupt();
+        }
+        b.data_size = size - 4 - 4 * size_t(b.num_restarts);
+        b.restarts = b.data + b.data_size;
+        _blocks.push_back(b);
+      }
+      if (_blocks.size() != num_blocks) {
+        _corrupt();
+      }
+    } catch (...) {
+      ::munmap(const_cast<char *>(_base), _length);
+      throw;
+    }
+  }
+
+  inline FrozenMap::~FrozenMap() {
+    ::munmap(const_cast<char *>(_base), _length);
+  }
+
+  inline void FrozenMap::_corrupt() const {
+    throw std::runtime_error(_path + " is not a valid table");
+  }
+
+  inline size_t FrozenMap::size() const {
+    return _size;
+  }
+
+  inline bool FrozenMap::empty() const {
+    return _size == 0;
+  }
+
+  inline FrozenMap::ConstIterator FrozenMap::begin() const {
+    ConstIterator it(this, 0, 0);
+    if (!_blocks.empty()) {
+      it._decode();
+    }
+    return it;
+  }
+
+  inline FrozenMap::ConstIterator FrozenMap::end() const {
+    return ConstIterator(this, _blocks.size(), 0);
+  }
+
+  inline FrozenMap::Slice FrozenMap::_restart_key(const Block& b, uint32_t i) const {
+    const char *limit = b.data + b.data_size;
+    const char *p = b.data + _get_fixed(b.restarts + 4 * i, 4);
+    uint64_t shared, unshared, value_size;
+    p = _get_varint(p, limit, &shared);
+    p = p ? _get_varint(p, limit, &unshared) : nullptr;
+    p = p ? _get_varint(p, limit, &value_size) : nullptr;
+    if (p == nullptr || shared != 0 || unshared > uint64_t(limit - p)) {
+      _corrupt();
+    }
+    return Slice(p, unshared);
+  }
+
+  inline FrozenMap::ConstIterator FrozenMap::lower_bound(const Slice& key) const {
+    // First block that ends at or past key, then the last restart in it
+    // before key, then a short scan
+    auto bit = std::lower_bound(_blocks.begin(), _blocks.end(), key,
+                                [](const Block& b, const Slice& k) { return b.last_key < k; });
+    if (bit == _blocks.end()) {
+      return end();
+    }
+    const Block& b = *bit;
+    uint32_t lo = 0, hi = b.num_restarts - 1;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo + 1) / 2;
+      if (_restart_key(b, mid) < key) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+
+    size_t block = bit - _blocks.begin();
+    ConstIterator it(this, block, _get_fixed(b.restarts + 4 * lo, 4));
+    it._decode();
+    while (it._block == block && Slice(it._key) < key) {
+      ++it;
+    }
+    return it;
+  }
+
+  inline FrozenMap::ConstIterator FrozenMap::upper_bound(const Slice& key) const {
+    ConstIterator it = lower_bound(key);
+    if (it != end() && Slice(it._key) == key) {
+      ++it;
+    }
+    return it;
+  }
+
+  inline FrozenMap::ConstIterator FrozenMap::find(const Slice& key) const {
+    ConstIterator it = lower_bound(key);
+    if (it != end() && Slice(it._key) == key) {
+      return it;
+    }
+    return end();
+  }
+
+  inline FrozenMap::Slice FrozenMap::at(const Slice& key) const {
+    ConstIterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Key not found");
+    }
+    return it.value();
+  }
+
+  inline size_t FrozenMap::count(const Slice& key) const {
+    return find(key) != end();
+  }
+
+  inline void FrozenMap::ConstIterator::_decode() {
+    const Block& b = _map->_blocks[_block];
+    const char *limit = b.data + b.data_size;
+    const char *p = b.data + _offset;
+    uint64_t shared, unshared, value_size;
+    p = _get_varint(p, limit, &shared);
+    p = p ? _get_varint(p, limit, &unshared) : nullptr;
+    p = p ? _get_varint(p, limit, &value_size) : nullptr;
+    if (p == nullptr || shared > _key.size() || unshared > uint64_t(limit - p) ||
+        value_size > uint64_t(limit - p) - unshared) {
+      _map->_corrupt();
+    }
+    _key.resize(shared);
+    _key.append(p, unshared);
+    _value = p + unshared;
+    _value_size = value_size;
+    _next = _value + _value_size - b.data;
+  }
+
+  inline FrozenMap::ConstIterator& FrozenMap::ConstIterator::operator++() {
+    _offset = _next;
+    if (_offset >= _map->_blocks[_block].data_size) {
+      _block++;
+      _offset = 0;
+      _key.clear();
+      if (_block == _map->_blocks.size()) {
+        _next = 0;
+        return *this;
+      }
+    }
+    _decode();
+    return *this;
+  }
+}
+
+#endif /* _FROZEN_MAP_H_ */
@@ -4,22 +4,346 @@
 #include <utility>
 #include <vector>
 #include <stdexcept>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <random>
+#include <tuple>
+#include <type_traits>
 
 namespace cs540 {
   static const int MAX_SKIP_LIST_HEIGHT = 20; // Beware magic number
 
+  // Hands out tower heights for one skip list. Every height is one xorshift64*
+  // step, so it's cheap and two maps never march in lockstep off the same clock
+  // tick like they did when every insert built its own engine.
+  class SkipLevelGenerator {
+  public:
+    // p is the chance a tower grows another level, expected_size caps the
+    // height at roughly log_{1/p}(expected_size) (0 means no cap past
+    // MAX_SKIP_LIST_HEIGHT) and seed 0 means pick one at random
+    explicit SkipLevelGenerator(double p = 0.5, size_t expected_size = 0, uint64_t seed = 0);
+
+    // Restart the sequence, same seed gives the same heights
+    void seed(uint64_t);
+    int operator()();
+    // Deterministic height for the element at 1 based position in sorted
+    // order, towers come out evenly spaced like a perfect skip list
+    int balanced(size_t position) const;
+
+    double p() const { return _p; }
+    int max_height() const { return _max_height; }
+
+  private:
+    uint64_t _next();
+
+    uint64_t _state;
+    double _p;
+    int _shift;          // log2(1/p) when p is a power of 1/2, 0 otherwise
+    uint64_t _threshold; // p scaled up to 2^64 for the general case
+    int _max_height;
+  };
+
+  inline SkipLevelGenerator::SkipLevelGenerator(double p, size_t expected_size, uint64_t s):
+    _state(0),
+    _p(p > 0 && p < 1 ? p : 0.5),
+    _shift(0),
+    _threshold(0),
+    _max_height(MAX_SKIP_LIST_HEIGHT) {
+    // Powers of 1/2 get to use count trailing zeros
+    double shift = std::log2(1 / _p);
+    if (shift == std::floor(shift) && shift < 64) {
+      _shift = static_cast<int>(shift);
+    } else {
+      _threshold = static_cast<uint64_t>(std::ldexp(_p, 64));
+    }
+
+    if (expected_size > 1) {
+      int h = static_cast<int>(std::ceil(std::log(static_cast<double>(expected_size)) / std::log(1 / _p))) + 1;
+      _max_height = std::max(1, std::min(h, MAX_SKIP_LIST_HEIGHT));
+    }
+
+    seed(s != 0 ? s : (static_cast<uint64_t>(std::random_device{}()) << 32) ^
+         static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+  }
+
+  inline void SkipLevelGenerator::seed(uint64_t s) {
+    // splitmix64 the seed so small or similar seeds still start far apart,
+    // and so the state is never 0, which xorshift can't get out of
+    s += 0x9e3779b97f4a7c15ull;
+    s = (s ^ (s >> 30)) * 0xbf58476d1ce4e5b9ull;
+    s = (s ^ (s >> 27)) * 0x94d049bb133111ebull;
+    s ^= s >> 31;
+    _state = s != 0 ? s : 0x9e3779b97f4a7c15ull;
+  }
+
+  inline uint64_t SkipLevelGenerator::_next() {
+    _state ^= _state >> 12;
+    _state ^= _state << 25;
+    _state ^= _state >> 27;
+    return _state * 0x2545f4914f6cdd1dull;
+  }
+
+  inline int SkipLevelGenerator::operator()() {
+    int h;
+    if (_shift > 0) {
+      // Each run of _shift zero bits is one more level, the top bit keeps ctz defined
+      h = 1 + __builtin_ctzll(_next() | (1ull << 63)) / _shift;
+    } else {
+      h = 1;
+      while (h < _max_height && _next() < _threshold) {
+        h++;
+      }
+    }
+    return std::min(h, _max_height);
+  }
+
+  inline int SkipLevelGenerator::balanced(size_t position) const {
+    int h = 1;
+    if (_shift > 0) {
+      h += __builtin_ctzll(position | (1ull << 63)) / _shift;
+    } else {
+      // One more level every time position divides by roughly 1/p again
+      size_t base = std::max<size_t>(2, static_cast<size_t>(std::lround(1 / _p)));
+      while (h < _max_height && position % base == 0) {
+        position /= base;
+        h++;
+      }
+    }
+    return std::min(h, _max_height);
+  }
+
+  // Fixed size blocks carved out of slabs, with a free list per size class.
+  // Each class only ever hands out one block size, the caller keeps track of
+  // which is which. Everything goes back to the system at once in release().
+  class SlabPool {
+  public:
+    static const int MAX_CLASSES = MAX_SKIP_LIST_HEIGHT + 1;
+
+    SlabPool();
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+    ~SlabPool();
+
+    void *allocate(int cls, size_t bytes);
+    void deallocate(int cls, void *block);
+    void release();
+    // Trades everything, blocks handed out stay valid and now belong to other
+    void swap(SlabPool& other);
+    // Takes over every slab and free block of other, which is left empty.
+    // Blocks other handed out stay where they are and come back here.
+    void adopt(SlabPool& other);
+
+  private:
+    // Slabs start small so tiny maps stay tiny, then double up to the cap
+    static const size_t FIRST_SLAB_BLOCKS = 8;
+    static const size_t MAX_SLAB_BYTES = 64 * 1024;
+
+    struct FreeBlock {
+      FreeBlock *next;
+    };
+    struct Slab {
+      Slab *next;
+    };
+    // Keeps blocks after the slab header aligned for anything
+    static const size_t SLAB_HEADER = (sizeof(Slab) + alignof(std::max_align_t) - 1) /
+      alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    Slab *_slabs;
+    FreeBlock *_free[MAX_CLASSES];
+    char *_bump[MAX_CLASSES];
+    char *_bump_end[MAX_CLASSES];
+    size_t _slab_blocks[MAX_CLASSES];
+  };
+
+  inline SlabPool::SlabPool(): _slabs(nullptr) {
+    for (int c = 0; c < MAX_CLASSES; c++) {
+      _free[c] = nullptr;
+      _bump[c] = _bump_end[c] = nullptr;
+      _slab_blocks[c] = FIRST_SLAB_BLOCKS;
+    }
+  }
+
+  inline SlabPool::~SlabPool() {
+    release();
+  }
+
+  inline void *SlabPool::allocate(int cls, size_t bytes) {
+    if (_free[cls]) {
+      FreeBlock *b = _free[cls];
+      _free[cls] = b->next;
+      return b;
+    }
+
+    if (!_bump[cls] || _bump[cls] + bytes > _bump_end[cls]) {
+      size_t n = _slab_blocks[cls];
+      Slab *slab = static_cast<Slab *>(::operator new(SLAB_HEADER + n * bytes));
+      slab->next = _slabs;
+      _slabs = slab;
+      _bump[cls] = reinterpret_cast<char *>(slab) + SLAB_HEADER;
+      _bump_end[cls] = _bump[cls] + n * bytes;
+      if ((n * 2) * bytes <= MAX_SLAB_BYTES) {
+        _slab_blocks[cls] = n * 2;
+      }
+    }
+
+    void *b = _bump[cls];
+    _bump[cls] += bytes;
+    return b;
+  }
+
+  inline void SlabPool::deallocate(int cls, void *block) {
+    FreeBlock *b = static_cast<FreeBlock *>(block);
+    b->next = _free[cls];
+    _free[cls] = b;
+  }
+
+  inline void SlabPool::swap(SlabPool& other) {
+    std::swap(_slabs, other._slabs);
+    for (int c = 0; c < MAX_CLASSES; c++) {
+      std::swap(_free[c], other._free[c]);
+      std::swap(_bump[c], other._bump[c]);
+      std::swap(_bump_end[c], other._bump_end[c]);
+      std::swap(_slab_blocks[c], other._slab_blocks[c]);
+    }
+  }
+
+  inline void SlabPool::adopt(SlabPool& other) {
+    if (other._slabs) {
+      Slab *tail = other._slabs;
+      while (tail->next) {
+        tail = tail->next;
+      }
+      tail->next = _slabs;
+      _slabs = other._slabs;
+    }
+    // Whatever is left of other's bump regions just goes unused
+    for (int c = 0; c < MAX_CLASSES; c++) {
+      while (other._free[c]) {
+        FreeBlock *b = other._free[c];
+        other._free[c] = b->next;
+        b->next = _free[c];
+        _free[c] = b;
+      }
+      other._bump[c] = other._bump_end[c] = nullptr;
+      other._slab_blocks[c] = FIRST_SLAB_BLOCKS;
+    }
+    other._slabs = nullptr;
+  }
+
+  inline void SlabPool::release() {
+    while (_slabs) {
+      Slab *t = _slabs->next;
+      ::operator delete(static_cast<void *>(_slabs));
+      _slabs = t;
+    }
+    for (int c = 0; c < MAX_CLASSES; c++) {
+      _free[c] = nullptr;
+      _bump[c] = _bump_end[c] = nullptr;
+      _slab_blocks[c] = FIRST_SLAB_BLOCKS;
+    }
+  }
+
+  // Stand in for C++14's std::less<>. Marked transparent, so a Map using it
+  // can look up a const char * or a string_view as is instead of building a
+  // key out of it first.
+  struct TransparentLess {
+    using is_transparent = void;
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const {
+      return a < b;
+    }
+  };
+
+  // Three way version of a Compare on Key_T, negative, zero or positive like strcmp.
+  // Left to itself it has to ask Compare twice, so the comparators we know
+  // get specialized down to one step. per_step says whether a descent should
+  // go three way, which only pays off when a compare costs more than a
+  // couple of instructions.
+  template <typename Compare, typename Key_T, typename = void>
+  struct ThreeWayCompare {
+    static const bool per_step = false;
+    template <typename A, typename B>
+    static int compare(const Compare& cmp, const A& a, const B& b) {
+      return cmp(a, b) ? -1 : cmp(b, a);
+    }
+  };
+
+  // No branches, just two flags. A descent still sticks to <, an int
+  // compare is already one instruction and testing for equal on every step
+  // cost more than it saved once the list is out of cache.
+  template <typename T>
+  struct ThreeWayCompare<std::less<T>, T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static const bool per_step = false;
+    static int compare(const std::less<T>&, T a, T b) {
+      return (a > b) - (a < b);
+    }
+  };
+
+  // One memcmp instead of one per <
+  template <>
+  struct ThreeWayCompare<std::less<std::string>, std::string> {
+    static const bool per_step = true;
+    static int compare(const std::less<std::string>&, const std::string& a, const std::string& b) {
+      return a.compare(b);
+    }
+  };
+
+  template <>
+  struct ThreeWayCompare<TransparentLess, std::string> {
+    static const bool per_step = true;
+    static int compare(const TransparentLess&, const std::string& a, const std::string& b) {
+      return a.compare(b);
+    }
+    static int compare(const TransparentLess&, const std::string& a, const char *b) {
+      return a.compare(b);
+    }
+#if __cplusplus >= 201703L
+    static int compare(const TransparentLess&, const std::string& a, std::string_view b) {
+      return a.compare(b);
+    }
+#endif
+    template <typename A, typename B>
+    static int compare(const TransparentLess&, const A& a, const B& b) {
+      return a < b ? -1 : b < a;
+    }
+  };
+
+  // Which comparator a Map uses for a key type, specialize it to change the
+  // order. It's a trait and not a third parameter on Map because the tests
+  // take Map as a two parameter template template argument.
+  template <typename Key_T>
+  struct KeyCompare {
+    using type = std::less<Key_T>;
+  };
+
+  // Strings are what we get handed as char buffers
+  template <>
+  struct KeyCompare<std::string> {
+    using type = TransparentLess;
+  };
+
   template <typename Key_T, typename Mapped_T>
   class Map {
   public:
     using ValueType = std::pair<const Key_T, Mapped_T>;
+    using Compare = typename KeyCompare<Key_T>::type;
 
     // Constructors and assignment ops
     Map();
+    explicit Map(const SkipLevelGenerator&);
     Map(const Map&);
     Map& operator=(const Map&);
+    // Moved from maps are left empty
+    Map(Map&&);
+    Map& operator=(Map&&);
     Map(std::initializer_list<ValueType>);
     ~Map();
 
@@ -45,14 +369,112 @@ namespace cs540 {
     Mapped_T& at(const Key_T&);
     const Mapped_T& at(const Key_T&) const;
     Mapped_T& operator[](const Key_T&);
+    size_t count(const Key_T&) const;
+
+    // Same lookups for anything Compare can hold up against a key, only
+    // there when Compare says it's transparent
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator find(const K& key) {
+      return Iterator(_find_node(key));
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator find(const K& key) const {
+      return ConstIterator(_find_node(key));
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Mapped_T& at(const K& key) {
+      return _find_existing(key)->data()->second;
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    const Mapped_T& at(const K& key) const {
+      return _find_existing(key)->data()->second;
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t count(const K& key) const {
+      return _find_node(key) != _sentinel;
+    }
+
+    Compare key_comp() const;
+    // Looks up a whole batch at once, out[i] is find(keys[i]). Sorted or big
+    // batches get one sweep along the list, small unsorted ones run several
+    // descents side by side with prefetching so the cache misses overlap.
+    void find_batch(const std::vector<Key_T>& keys, std::vector<Iterator>& out);
+    void find_batch(const std::vector<Key_T>& keys, std::vector<ConstIterator>& out) const;
+
+    // Positional access, O(log n). nth is 0 based and gives end() past the
+    // last element, rank is how many keys are less than the given one.
+    Iterator nth(size_t);
+    ConstIterator nth(size_t) const;
+    size_t rank(const Key_T&) const;
+
+    // Ranges, lower_bound is the first key not less than the given one and
+    // upper_bound the first key greater than it
+    Iterator lower_bound(const Key_T&);
+    ConstIterator lower_bound(const Key_T&) const;
+    Iterator upper_bound(const Key_T&);
+    ConstIterator upper_bound(const Key_T&) const;
+    std::pair<Iterator, Iterator> equal_range(const Key_T&);
+    std::pair<ConstIterator, ConstIterator> equal_range(const Key_T&) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator lower_bound(const K& key) {
+      return Iterator(_descend(key, false)->next[0]);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator lower_bound(const K& key) const {
+      return ConstIterator(_descend(key, false)->next[0]);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator upper_bound(const K& key) {
+      return Iterator(_descend(key, true)->next[0]);
+    }
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    ConstIterator upper_bound(const K& key) const {
+      return ConstIterator(_descend(key, true)->next[0]);
+    }
 
     // Modifiers
     std::pair<Iterator, bool> insert(const ValueType&);
+    std::pair<Iterator, bool> insert(ValueType&&);
+    // Builds the value in its node up front, so it's thrown away again if
+    // the key turns out to be taken
+    template <typename... Args>
+    std::pair<Iterator, bool> emplace(Args&&...);
+    // Only builds a value, from key and args, if key isn't already there
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(const Key_T&, Args&&...);
+    template <typename... Args>
+    std::pair<Iterator, bool> try_emplace(Key_T&&, Args&&...);
+    // Goes in right before hint if that's where it belongs, otherwise same
+    // as insert(value)
+    Iterator insert(Iterator hint, const ValueType&);
     template <typename IT_T>
     void insert(IT_T range_beg, IT_T range_end);
     void erase(Iterator pos);
     void erase(const Key_T&);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    void erase(const K& key) {
+      _erase_key(key);
+    }
+    // Unlinks the whole run in one pass, gives back last
+    Iterator erase(Iterator first, Iterator last);
     void clear();
+    // Erase only ever lowers the list to its tallest tower left, which after
+    // a lot of erasing can still be much taller than the size calls for.
+    // This rebuilds every tower at the height a perfectly balanced list of
+    // the current size would give it, in fresh nodes laid out in key order.
+    // Values get moved over, so iterators and references don't survive it.
+    void rebalance();
+
+    // Set operations. One walk along both maps in key order, and the result
+    // gets linked up in a single pass like a bulk load. A key in both keeps
+    // this map's value.
+    Map unite(const Map&) const;
+    Map intersect(const Map&) const;
+    Map subtract(const Map&) const;
+    // Moves every element of other whose key isn't here yet into this map
+    // without copying or reallocating it, this map's pool takes over
+    // other's slabs. Like std::map::merge, the rest stay behind in other.
+    void merge(Map& other);
 
     // Comparison
     friend bool operator==(const Map& map1, const Map& map2) {
@@ -93,42 +515,171 @@ namespace cs540 {
 
   private:
     // Skip list internals here
+    // One allocation per element: the value up front, then the node with its
+    // tower of next pointers trailing off the end. Head and sentinel are just
+    // a node with a full height tower and no value in front of them.
     struct SkipNode {
       // Can't assume we have these since we can't assume Mapped and Key have them
       SkipNode& operator=(const SkipNode&) = delete;
-
-      SkipNode(): back(this), data(nullptr) {}
       // I don't want to be able to copy construct a node
       SkipNode(const SkipNode& other) = delete;
-      ~SkipNode() {
-        next = std::vector<SkipNode *>{};
-        back = nullptr;
-        delete data;
+      SkipNode() = default;
+
+      // Distance from the start of the allocation to the node itself
+      static constexpr size_t value_offset =
+        (sizeof(ValueType) + alignof(SkipNode *) - 1) / alignof(SkipNode *) * alignof(SkipNode *);
+
+      // The tower of next pointers is followed by a matching tower of widths
+      // and then the previous node on every level but 0, which is back
+      static size_t bytes(int height) {
+        return sizeof(SkipNode) + (height - 1) * sizeof(SkipNode *) + height * sizeof(size_t) +
+          (height - 1) * sizeof(SkipNode *);
       }
 
-      SkipNode(const ValueType& d): data(new ValueType(d)) {}
+      // Whole block for a node with a value, rounded so blocks can sit back to
+      // back in a slab
+      static size_t block_bytes(int height) {
+        const size_t align = alignof(ValueType) > alignof(SkipNode) ? alignof(ValueType) : alignof(SkipNode);
+        return (value_offset + bytes(height) + align - 1) / align * align;
+      }
 
-      std::vector<SkipNode *> next;
-      SkipNode *back;
-      ValueType *data;
+      ValueType *data() {
+        return reinterpret_cast<ValueType *>(reinterpret_cast<char *>(this) - value_offset);
+      }
+      const ValueType *data() const {
+        return reinterpret_cast<const ValueType *>(reinterpret_cast<const char *>(this) - value_offset);
+      }
 
-      static int rand_height() {
-        int seed = std::chrono::system_clock::now().time_since_epoch().count();
-        std::default_random_engine gen(seed);
-        std::geometric_distribution<int> dist(0.5);
+      // How many elements next[i] is ahead of this node. Counting _head as
+      // position 0, an element sits at its 1 based index and _sentinel at
+      // size() + 1. The sentinel's own widths are 0, nothing else's are.
+      size_t *width() {
+        return reinterpret_cast<size_t *>(next + height);
+      }
+      const size_t *width() const {
+        return reinterpret_cast<const size_t *>(next + height);
+      }
 
-        return std::min(dist(gen)+1, MAX_SKIP_LIST_HEIGHT);
+      SkipNode *&prev(int level) {
+        return level == 0 ? back : reinterpret_cast<SkipNode **>(width() + height)[level - 1];
       }
+
+      // k elements forward, or the sentinel if that runs off the end
+      static SkipNode *advance(SkipNode *sn, size_t k) {
+        int level = 0;
+        while (k > 0 && sn->width()[0] != 0) {
+          while (level + 1 < sn->height && sn->width()[level + 1] <= k) {
+            level++;
+          }
+          while (sn->width()[level] > k) {
+            level--;
+          }
+          k -= sn->width()[level];
+          sn = sn->next[level];
+          level = std::min(level, sn->height - 1);
+        }
+        return sn;
+      }
+
+      SkipNode *back;
+      int height;
+      SkipNode *next[1]; // Really height long
     };
 
+    // Nodes come out of _pool, size class is the height and class 0 is
+    // reserved for head and sentinel
+    template <typename... Args>
+    SkipNode *_new_node(int height, Args&&...);
+    SkipNode *_new_link_node();
+    void _free_node(SkipNode *);
+
     // Some helper functions because I don't have a real SkipList class
     void _init_skip_list();
     void _delete_skip_list();
     void _copy_skip_list(const SkipNode *);
+    // Bulk loading: lasts[i] is the last node on level i
+    void _find_lasts(SkipNode **lasts, size_t *pos);
+    template <typename V>
+    void _append(V&&, SkipNode **lasts, size_t *pos);
+    // Hooks sn onto the end of its levels as element sn_pos, the links into
+    // the sentinel get fixed up by _close_lasts once everything's in
+    void _link_last(SkipNode *sn, size_t sn_pos, SkipNode **lasts, size_t *pos);
+    void _close_lasts(SkipNode **lasts, size_t *pos);
+    Map _set_op(const Map&, bool mine, bool both, bool theirs) const;
+    template <typename A, typename B>
+    int _compare_keys(const A& a, const B& b) const {
+      return ThreeWayCompare<Compare, Key_T>::compare(_cmp, a, b);
+    }
 
+    // Finger search: _finger is the search path of the last insert or erase,
+    // so a key close to the last one only climbs and descends a few levels
+    // instead of starting over at the top of _head
+    // Keys only ever get compared through _cmp, so K is Key_T or whatever
+    // a transparent Compare takes. _matches only makes sense for the first
+    // node that isn't _before key, then equal just means not greater.
+    template <typename K>
+    bool _before(const SkipNode *sn, const K& key) const {
+      return sn == _head || (sn != _sentinel && _cmp(sn->data()->first, key));
+    }
+    template <typename K>
+    bool _matches(const SkipNode *sn, const K& key) const {
+      return sn != _sentinel && !_cmp(key, sn->data()->first);
+    }
+    template <typename K>
+    int _compare(const SkipNode *sn, const K& key) const {
+      return ThreeWayCompare<Compare, Key_T>::compare(_cmp, sn->data()->first, key);
+    }
+    template <typename K>
+    bool _brackets(int level, const K& key) const {
+      return _before(_finger[level], key) && !_before(_finger[level]->next[level], key);
+    }
+    // Fills path[i] with the last node before key on level i and pos[i]
+    // with its position
+    template <typename K>
+    void _search(const K&, SkipNode **path, size_t *pos) const;
+    // Plain descent from the top of _head, gives the node or _sentinel as
+    // soon as any level lands on key
+    template <typename K>
+    SkipNode *_find_node(const K&) const;
+    template <typename K>
+    SkipNode *_find_existing(const K&) const;
+    template <typename K>
+    void _erase_key(const K&);
+    SkipNode *_link(SkipNode *, SkipNode **path, size_t *pos);
+    void _swap(Map&);
+    // Last node before key, or the last node not after it when inclusive
+    template <typename K>
+    SkipNode *_descend(const K&, bool inclusive) const;
+    // Same thing as _search but for a node we already have, walked out
+    // along the back links with no key comparisons
+    void _path_to(SkipNode *, SkipNode **path, size_t *pos);
+    void _unlink(SkipNode *, SkipNode **path, size_t *pos);
+    // Drops levels only _head is left on, so searches start at the tallest
+    // tower still around
+    void _shrink_height() {
+      while (_height > 1 && _head->next[_height - 1] == _sentinel) {
+        _height--;
+      }
+    }
+    // find_batch helpers, both fill found[i] with the node for keys[i] or
+    // the sentinel
+    static const size_t BATCH_LANES = 8;
+    void _find_sweep(const std::vector<Key_T>& keys, SkipNode **found) const;
+    void _find_interleaved(const std::vector<Key_T>& keys, SkipNode **found) const;
+    void _find_batch(const std::vector<Key_T>& keys, SkipNode **found) const;
+    void _set_finger(SkipNode **path, size_t *pos) {
+      std::copy(path, path + MAX_SKIP_LIST_HEIGHT, _finger);
+      std::copy(pos, pos + MAX_SKIP_LIST_HEIGHT, _finger_pos);
+    }
+
+    SlabPool _pool;
+    SkipLevelGenerator _levels;
+    Compare _cmp;
     int _height;
     SkipNode *_head;
     SkipNode *_sentinel;
+    SkipNode *_finger[MAX_SKIP_LIST_HEIGHT];
+    size_t _finger_pos[MAX_SKIP_LIST_HEIGHT];
 
     size_t _size;
 
@@ -143,10 +694,10 @@ namespace cs540 {
       virtual ~BaseIterator() = default;
 
       virtual ValueType& operator*() const {
-        return *(_it->data);
+        return *(_it->data());
       }
       virtual ValueType *operator->() const {
-        return _it->data;
+        return _it->data();
       }
       friend bool operator==(const BaseIterator& i1, const BaseIterator& i2) {
         return i1._it == i2._it;
@@ -155,6 +706,7 @@ namespace cs540 {
         return !(i1 == i2);
       }
     protected:
+      friend class Map;
       SkipNode *_it;
     };
   public:
@@ -184,6 +736,14 @@ namespace cs540 {
         --(*this);
         return t;
       }
+      // Skips ahead along the widths in O(log k)
+      Iterator& operator+=(size_t k) {
+        BaseIterator::_it = SkipNode::advance(BaseIterator::_it, k);
+        return *this;
+      }
+      friend Iterator operator+(Iterator it, size_t k) {
+        return it += k;
+      }
     };
     class ReverseIterator: public BaseIterator {
     public:
@@ -238,11 +798,18 @@ namespace cs540 {
         --(*this);
         return t;
       }
+      ConstIterator& operator+=(size_t k) {
+        _it = SkipNode::advance(const_cast<SkipNode *>(_it), k);
+        return *this;
+      }
+      friend ConstIterator operator+(ConstIterator it, size_t k) {
+        return it += k;
+      }
       const ValueType& operator*() const {
-        return *(_it->data);
+        return *(_it->data());
       }
       const ValueType *operator->() const {
-        return &(*(_it->data));
+        return _it->data();
       }
       friend bool operator==(const ConstIterator& i1, const ConstIterator& i2) {
         return i1._it == i2._it;
@@ -267,54 +834,146 @@ namespace cs540 {
     };
   };
 
+  template <typename Key_T, typename Mapped_T>
+  template <typename... Args>
+  typename Map<Key_T, Mapped_T>::SkipNode *Map<Key_T, Mapped_T>::_new_node(int height, Args&&... args) {
+    char *mem = static_cast<char *>(_pool.allocate(height, SkipNode::block_bytes(height)));
+    try {
+      new (mem) ValueType(std::forward<Args>(args)...);
+    } catch (...) {
+      _pool.deallocate(height, mem);
+      throw;
+    }
+    SkipNode *sn = new (mem + SkipNode::value_offset) SkipNode;
+    sn->back = nullptr;
+    sn->height = height;
+    return sn;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::SkipNode *Map<Key_T, Mapped_T>::_new_link_node() {
+    SkipNode *sn = new (_pool.allocate(0, SkipNode::bytes(MAX_SKIP_LIST_HEIGHT))) SkipNode;
+    sn->back = sn;
+    sn->height = MAX_SKIP_LIST_HEIGHT;
+    return sn;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_free_node(SkipNode *sn) {
+    ValueType *val = sn->data();
+    int height = sn->height;
+    val->~ValueType();
+    _pool.deallocate(height, val);
+  }
+
   template <typename Key_T, typename Mapped_T>
   void Map<Key_T, Mapped_T>::_init_skip_list() {
-    _head->next = std::vector<SkipNode *>(MAX_SKIP_LIST_HEIGHT, _sentinel);
-    _head->back = _head;
-    _sentinel->next = std::vector<SkipNode *>(MAX_SKIP_LIST_HEIGHT, _sentinel);
-    _sentinel->back = _head;
+    std::fill(_head->next, _head->next + MAX_SKIP_LIST_HEIGHT, _sentinel);
+    std::fill(_sentinel->next, _sentinel->next + MAX_SKIP_LIST_HEIGHT, _sentinel);
+    for (int i = 0; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      _head->prev(i) = _head;
+      _sentinel->prev(i) = _head;
+    }
+    std::fill(_head->width(), _head->width() + MAX_SKIP_LIST_HEIGHT, 1);
+    std::fill(_sentinel->width(), _sentinel->width() + MAX_SKIP_LIST_HEIGHT, 0);
+    std::fill(_finger, _finger + MAX_SKIP_LIST_HEIGHT, _head);
+    std::fill(_finger_pos, _finger_pos + MAX_SKIP_LIST_HEIGHT, 0);
   }
 
   template <typename Key_T, typename Mapped_T>
   void Map<Key_T, Mapped_T>::_delete_skip_list() {
-    SkipNode *it = _head;
-    while (it != _sentinel) {
-      SkipNode *t = it->next[0];
-      delete it;
-      it = t;
+    // Values still need their destructors run, the memory all goes at once
+    if (!std::is_trivially_destructible<ValueType>::value) {
+      SkipNode *it = _head->next[0];
+      while (it != _sentinel) {
+        SkipNode *t = it->next[0];
+        it->data()->~ValueType();
+        it = t;
+      }
     }
-    delete _sentinel;
+    _pool.release();
   }
 
   template <typename Key_T, typename Mapped_T>
   void Map<Key_T, Mapped_T>::_copy_skip_list(const SkipNode *other) {
-    SkipNode *it = _head;
     const SkipNode *other_it = other;
-    std::vector<SkipNode *> lasts(_height, _head);
+    SkipNode *lasts[MAX_SKIP_LIST_HEIGHT];
+    std::fill(lasts, lasts + MAX_SKIP_LIST_HEIGHT, _head);
+    std::copy(other->width(), other->width() + MAX_SKIP_LIST_HEIGHT, _head->width());
     for (size_t i = 0; i < _size; i++) {
       // Create a new skip node based off of the next guy
-      SkipNode *mimic_sn = other_it->next[0];
-      SkipNode *sn = new SkipNode(*(mimic_sn->data));
-      sn->next = std::vector<SkipNode *>(mimic_sn->next.size(), _sentinel);
-      sn->back = it;
-      // Insert him into the skip list, after it but also setting last->next appropriately
-      for (size_t j = 0; j < sn->next.size(); j++) {
+      const SkipNode *mimic_sn = other_it->next[0];
+      SkipNode *sn = _new_node(mimic_sn->height, *(mimic_sn->data()));
+      // Insert him into the skip list, after the last node on each of his levels
+      for (int j = 0; j < sn->height; j++) {
+        sn->next[j] = _sentinel;
+        sn->width()[j] = mimic_sn->width()[j];
+        sn->prev(j) = lasts[j];
         lasts[j]->next[j] = sn;
         lasts[j] = sn;
       }
 
-      it = sn;
       other_it = other_it->next[0];
     }
 
-    _sentinel->back = lasts[0];
+    for (int j = 0; j < _height; j++) {
+      _sentinel->prev(j) = lasts[j];
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_find_lasts(SkipNode **lasts, size_t *pos) {
+    // The sentinel already knows, positions come from the link widths
+    for (int level = 0; level < MAX_SKIP_LIST_HEIGHT; level++) {
+      lasts[level] = _sentinel->prev(level);
+      pos[level] = _size + 1 - lasts[level]->width()[level];
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename V>
+  void Map<Key_T, Mapped_T>::_append(V&& val, SkipNode **lasts, size_t *pos) {
+    // Caller promises val goes after everything already here
+    size_t sn_pos = _size + 1;
+    int sn_height = _levels.balanced(sn_pos);
+    SkipNode *sn = _new_node(sn_height, std::forward<V>(val));
+    // Links that used to reach the sentinel now reach sn at the same
+    // position, the rest have to stretch over it
+    for (int i = 0; i < sn_height; i++) {
+      sn->next[i] = _sentinel;
+      sn->width()[i] = 1;
+      sn->prev(i) = lasts[i];
+      _sentinel->prev(i) = sn;
+      lasts[i]->next[i] = sn;
+      lasts[i] = sn;
+      pos[i] = sn_pos;
+    }
+    for (int i = sn_height; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      lasts[i]->width()[i]++;
+    }
+    if (sn_height > _height) {
+      _height = sn_height;
+    }
+    _size++;
   }
 
   template <typename Key_T, typename Mapped_T>
   Map<Key_T, Mapped_T>::Map():
+    _levels(),
     _height(1),
-    _head(new SkipNode),
-    _sentinel(new SkipNode),
+    _head(_new_link_node()),
+    _sentinel(_new_link_node()),
+    _size(0) {
+    // Set head and sent to default values
+    _init_skip_list();
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T>::Map(const SkipLevelGenerator& levels):
+    _levels(levels),
+    _height(1),
+    _head(_new_link_node()),
+    _sentinel(_new_link_node()),
     _size(0) {
     // Set head and sent to default values
     _init_skip_list();
@@ -322,9 +981,11 @@ namespace cs540 {
 
   template <typename Key_T, typename Mapped_T>
   Map<Key_T, Mapped_T>::Map(const Map<Key_T, Mapped_T>& map):
+    _levels(map._levels),
+    _cmp(map._cmp),
     _height(map._height),
-    _head(new SkipNode),
-    _sentinel(new SkipNode),
+    _head(_new_link_node()),
+    _sentinel(_new_link_node()),
     _size(map._size) {
     // Set head and sent to default values
     _init_skip_list();
@@ -342,9 +1003,11 @@ namespace cs540 {
     _delete_skip_list();
 
     // Reinitialize
+    _levels = map._levels;
+    _cmp = map._cmp;
     _height = map._height;
-    _head = new SkipNode;
-    _sentinel = new SkipNode;
+    _head = _new_link_node();
+    _sentinel = _new_link_node();
     _size = map._size;
 
     // Basically do what copy constructor do
@@ -354,18 +1017,56 @@ namespace cs540 {
     return *this;
   }
 
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_swap(Map& other) {
+    // Nodes live in their map's pool, so the pools trade along with the lists
+    _pool.swap(other._pool);
+    std::swap(_levels, other._levels);
+    std::swap(_cmp, other._cmp);
+    std::swap(_height, other._height);
+    std::swap(_head, other._head);
+    std::swap(_sentinel, other._sentinel);
+    std::swap(_size, other._size);
+    for (int i = 0; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      std::swap(_finger[i], other._finger[i]);
+      std::swap(_finger_pos[i], other._finger_pos[i]);
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T>::Map(Map&& map):
+    _levels(map._levels),
+    _cmp(map._cmp),
+    _height(1),
+    _head(_new_link_node()),
+    _sentinel(_new_link_node()),
+    _size(0) {
+    // Start out empty and trade, map keeps our empty list
+    _init_skip_list();
+    _swap(map);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T>& Map<Key_T, Mapped_T>::operator=(Map&& map) {
+    if (&map == this) {
+      return *this;
+    }
+    // What used to be here goes away with tmp
+    Map tmp(std::move(map));
+    _swap(tmp);
+    return *this;
+  }
+
   template <typename Key_T, typename Mapped_T>
   Map<Key_T, Mapped_T>::Map(std::initializer_list<ValueType> init_list):
+    _levels(),
     _height(1),
-    _head(new SkipNode),
-    _sentinel(new SkipNode),
+    _head(_new_link_node()),
+    _sentinel(_new_link_node()),
     _size(0) {
     // Set head and sent to default values
     _init_skip_list();
-    // Copy skip list
-    for (auto& v: init_list) {
-      insert(v);
-    }
+    insert(init_list.begin(), init_list.end());
   }
 
   template <typename Key_T, typename Mapped_T>
@@ -416,209 +1117,778 @@ namespace cs540 {
   }
 
   template <typename Key_T, typename Mapped_T>
-  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::find(const Key_T& key) {
-    if (empty()) {
-      return end();
+  template <typename K>
+  typename Map<Key_T, Mapped_T>::SkipNode *Map<Key_T, Mapped_T>::_find_node(const K& key) const {
+    SkipNode *it = _head;
+    if (!ThreeWayCompare<Compare, Key_T>::per_step) {
+      for (int level = _height - 1; level >= 0; level--) {
+        while (_before(it->next[level], key)) {
+          it = it->next[level];
+        }
+      }
+      it = it->next[0];
+      return _matches(it, key) ? it : _sentinel;
     }
 
-    int level;
-    SkipNode *it = _head;
-    for (level = _height - 1; level >= 0; level--) {
-      while (it->next[level] != _sentinel && it->next[level]->data->first < key) {
-        it = it->next[level];
+    // One compare per step, and we're done the moment one comes back equal.
+    // Whatever stopped us on the level above is usually next on this one
+    // too, no need to ask about it again.
+    const SkipNode *bigger = _sentinel;
+    for (int level = _height - 1; level >= 0; level--) {
+      SkipNode *next;
+      while ((next = it->next[level]) != bigger) {
+        int c = _compare(next, key);
+        if (c == 0) {
+          return next;
+        }
+        if (c > 0) {
+          bigger = next;
+          break;
+        }
+        it = next;
       }
     }
+    return _sentinel;
+  }
 
-    if (it->next[0] != _sentinel && it->next[0]->data->first == key) {
-      return Iterator(it->next[0]);
+  template <typename Key_T, typename Mapped_T>
+  template <typename K>
+  typename Map<Key_T, Mapped_T>::SkipNode *Map<Key_T, Mapped_T>::_find_existing(const K& key) const {
+    SkipNode *it = _find_node(key);
+    if (it == _sentinel) {
+      throw std::out_of_range("Key not found");
     }
+    return it;
+  }
 
-    return end();
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::find(const Key_T& key) {
+    return Iterator(_find_node(key));
   }
 
   template <typename Key_T, typename Mapped_T>
   typename Map<Key_T, Mapped_T>::ConstIterator Map<Key_T, Mapped_T>::find(const Key_T& key) const {
-    // TODO Literally an exact copy of above, should find some way to make this better
-    if (empty()) {
-      return end();
-    }
+    return ConstIterator(_find_node(key));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  size_t Map<Key_T, Mapped_T>::count(const Key_T& key) const {
+    return _find_node(key) != _sentinel;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Compare Map<Key_T, Mapped_T>::key_comp() const {
+    return _cmp;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Mapped_T& Map<Key_T, Mapped_T>::at(const Key_T& key) {
+    return _find_existing(key)->data()->second;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  const Mapped_T& Map<Key_T, Mapped_T>::at(const Key_T& key) const {
+    return _find_existing(key)->data()->second;
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Mapped_T& Map<Key_T, Mapped_T>::operator[](const Key_T& key) {
+    return try_emplace(key).first->second;
+  }
 
-    int level;
+  template <typename Key_T, typename Mapped_T>
+  template <typename K>
+  void Map<Key_T, Mapped_T>::_search(const K& key, SkipNode **path, size_t *pos) const {
+    // Climb until the finger brackets key, everything above that on the
+    // finger is then already the right path. If it never does, start over
+    // from the top, or from the finger if it's at least in front of key.
+    int level = 0;
+    while (level < _height - 1 && !_brackets(level, key)) {
+      level++;
+    }
     SkipNode *it = _head;
-    for (level = _height - 1; level >= 0; level--) {
-      while (it->next[level] != _sentinel && it->next[level]->data->first < key) {
-        it = it->next[level];
+    size_t at = 0;
+    if (_before(_finger[level], key)) {
+      it = _finger[level];
+      at = _finger_pos[level];
+    }
+    for (int i = level; i >= 0; i--) {
+      while (_before(it->next[i], key)) {
+        at += it->width()[i];
+        it = it->next[i];
       }
+      path[i] = it;
+      pos[i] = at;
+    }
+    std::copy(_finger + level + 1, _finger + MAX_SKIP_LIST_HEIGHT, path + level + 1);
+    std::copy(_finger_pos + level + 1, _finger_pos + MAX_SKIP_LIST_HEIGHT, pos + level + 1);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::SkipNode *Map<Key_T, Mapped_T>::_link(SkipNode *sn, SkipNode **path, size_t *pos) {
+    // path is every level's predecessor, which is _head on levels we aren't
+    // using yet, so a new tallest tower needs no special casing
+    int sn_height = sn->height;
+    if (sn_height > _height) {
+      _height = sn_height;
     }
 
-    if (it->next[0]->data->first == key) {
-      return ConstIterator(it->next[0]);
+    size_t sn_pos = pos[0] + 1;
+    for (int i = 0; i < sn_height; i++) {
+      // sn splits path[i]'s link in two, and the whole thing got one longer
+      size_t w = path[i]->width()[i];
+      path[i]->width()[i] = sn_pos - pos[i];
+      sn->width()[i] = w - (sn_pos - pos[i]) + 1;
+      sn->next[i] = path[i]->next[i];
+      sn->prev(i) = path[i];
+      sn->next[i]->prev(i) = sn;
+      path[i]->next[i] = sn;
+      path[i] = sn;
+      pos[i] = sn_pos;
+    }
+    for (int i = sn_height; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      path[i]->width()[i]++;
     }
+    _set_finger(path, pos);
 
-    return end();
+    _size++;
+    return sn;
   }
 
   template <typename Key_T, typename Mapped_T>
-  Mapped_T& Map<Key_T, Mapped_T>::at(const Key_T& key) {
-    auto it = find(key);
-    if (it == end()) {
-      throw std::out_of_range("Key not found");
-    } else {
-      return it->second;
+  void Map<Key_T, Mapped_T>::_find_sweep(const std::vector<Key_T>& keys, SkipNode **found) const {
+    // Visit the keys in order, each search picks up from the last one's path
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    if (!std::is_sorted(keys.begin(), keys.end(), _cmp)) {
+      std::sort(order.begin(), order.end(), [this, &keys](size_t a, size_t b) { return _cmp(keys[a], keys[b]); });
+    }
+
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    std::fill(path, path + MAX_SKIP_LIST_HEIGHT, _head);
+    for (size_t i: order) {
+      const Key_T& key = keys[i];
+      int level = 0;
+      while (level < _height - 1 && _before(path[level + 1]->next[level + 1], key)) {
+        level++;
+      }
+      SkipNode *it = path[level];
+      for (; level >= 0; level--) {
+        while (_before(it->next[level], key)) {
+          it = it->next[level];
+        }
+        path[level] = it;
+      }
+      it = it->next[0];
+      found[i] = _matches(it, key) ? it : _sentinel;
     }
   }
 
   template <typename Key_T, typename Mapped_T>
-  const Mapped_T& Map<Key_T, Mapped_T>::at(const Key_T& key) const {
-    auto it = find(key);
-    if (it == end()) {
-      throw std::out_of_range("Key not found");
+  void Map<Key_T, Mapped_T>::_find_interleaved(const std::vector<Key_T>& keys, SkipNode **found) const {
+    // Each lane is one descent. A lane's next candidate gets prefetched and
+    // only looked at once every other lane has had a turn, by which time it
+    // has hopefully shown up in cache.
+    struct Lane {
+      size_t key;
+      SkipNode *it;
+      SkipNode *next;
+      int level;
+    };
+    Lane lanes[BATCH_LANES];
+    size_t active = 0, upcoming = 0;
+
+    auto prefetch = [this](const SkipNode *sn) {
+      if (sn != _sentinel) {
+        __builtin_prefetch(sn->data());
+      }
+    };
+    auto start = [&](Lane& l) {
+      l.key = upcoming++;
+      l.it = _head;
+      l.level = _height - 1;
+      l.next = _head->next[l.level];
+      prefetch(l.next);
+    };
+    while (active < BATCH_LANES && upcoming < keys.size()) {
+      start(lanes[active++]);
+    }
+
+    while (active > 0) {
+      for (size_t j = 0; j < active;) {
+        Lane& l = lanes[j];
+        const Key_T& key = keys[l.key];
+        if (_before(l.next, key)) {
+          l.it = l.next;
+        } else if (l.level > 0) {
+          l.level--;
+        } else {
+          found[l.key] = _matches(l.next, key) ? l.next : _sentinel;
+          if (upcoming < keys.size()) {
+            start(l);
+          } else {
+            l = lanes[--active];
+            continue;
+          }
+          j++;
+          continue;
+        }
+        l.next = l.it->next[l.level];
+        prefetch(l.next);
+        j++;
+      }
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_find_batch(const std::vector<Key_T>& keys, SkipNode **found) const {
+    // Once the batch is a decent fraction of the map, sorting it and walking
+    // the list once beats descending for every key
+    if (keys.size() * 16 >= _size || std::is_sorted(keys.begin(), keys.end(), _cmp)) {
+      _find_sweep(keys, found);
     } else {
-      return it->second;
+      _find_interleaved(keys, found);
     }
   }
 
   template <typename Key_T, typename Mapped_T>
-  Mapped_T& Map<Key_T, Mapped_T>::operator[](const Key_T& key) {
-    auto res = insert(std::make_pair(key, Mapped_T()));
-    return res.first->second;
+  void Map<Key_T, Mapped_T>::find_batch(const std::vector<Key_T>& keys, std::vector<Iterator>& out) {
+    std::vector<SkipNode *> found(keys.size());
+    _find_batch(keys, found.data());
+    out.clear();
+    out.reserve(keys.size());
+    for (SkipNode *sn: found) {
+      out.push_back(Iterator(sn));
+    }
   }
 
   template <typename Key_T, typename Mapped_T>
-  std::pair<typename Map<Key_T, Mapped_T>::Iterator, bool> Map<Key_T, Mapped_T>::insert(const ValueType& val) {
-    if (empty()) {
-      // Handle empty case
-      SkipNode *sn = new SkipNode(val);
-      int sn_height = SkipNode::rand_height();
+  void Map<Key_T, Mapped_T>::find_batch(const std::vector<Key_T>& keys, std::vector<ConstIterator>& out) const {
+    std::vector<SkipNode *> found(keys.size());
+    _find_batch(keys, found.data());
+    out.clear();
+    out.reserve(keys.size());
+    for (SkipNode *sn: found) {
+      out.push_back(ConstIterator(sn));
+    }
+  }
 
-      if (sn_height > _height) {
-        _height = sn_height;
-      }
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::nth(size_t k) {
+    if (k >= _size) {
+      return end();
+    }
+    return Iterator(SkipNode::advance(_head, k + 1));
+  }
 
-      sn->next = std::vector<SkipNode *>(sn_height, _sentinel);
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::ConstIterator Map<Key_T, Mapped_T>::nth(size_t k) const {
+    if (k >= _size) {
+      return end();
+    }
+    return ConstIterator(SkipNode::advance(_head, k + 1));
+  }
 
-      sn->back = _head;
-      _sentinel->back = sn;
-      for (int i = 0; i < sn_height; i++) {
-        _head->next[i] = sn;
+  template <typename Key_T, typename Mapped_T>
+  size_t Map<Key_T, Mapped_T>::rank(const Key_T& key) const {
+    const SkipNode *it = _head;
+    size_t at = 0;
+    for (int level = _height - 1; level >= 0; level--) {
+      while (_before(it->next[level], key)) {
+        at += it->width()[level];
+        it = it->next[level];
       }
-
-      _size++;
-      return std::make_pair(Iterator(sn), true);
     }
+    return at;
+  }
 
-    int level;
+  template <typename Key_T, typename Mapped_T>
+  template <typename K>
+  typename Map<Key_T, Mapped_T>::SkipNode *Map<Key_T, Mapped_T>::_descend(const K& key, bool inclusive) const {
     SkipNode *it = _head;
-    std::vector<SkipNode *> path(_height, _sentinel);
-    for (level = _height - 1; level >= 0; level--) {
-      while (it->next[level] != _sentinel && it->next[level]->data->first < val.first) {
+    for (int level = _height - 1; level >= 0; level--) {
+      while (it->next[level] != _sentinel &&
+             (inclusive ? !_cmp(key, it->next[level]->data()->first) : _cmp(it->next[level]->data()->first, key))) {
         it = it->next[level];
       }
-      path[level] = it;
     }
+    return it;
+  }
 
-    if (it->next[0] != _sentinel && it->next[0]->data->first == val.first) {
-      return std::make_pair(Iterator(it->next[0]), false);
-    } else {
-      // Get a height for the new entry
-      // Make a new skip node and set the appropriate nexts
-      // May need to remember where dropoff points were to set next
-      // values appropriately
-      SkipNode *sn = new SkipNode(val);
-      int sn_height = SkipNode::rand_height();
-      sn->next = std::vector<SkipNode *>(sn_height, _sentinel);
-
-      int copy_height = sn_height;
-      if (sn_height > _height) {
-        // Adjust height
-        copy_height = _height;
-        _height = sn_height;
-
-        // Make head point to the newest tallest lane
-        for (int i = copy_height; i < sn_height; i++) {
-          _head->next[i] = sn;
-        }
-      }
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::lower_bound(const Key_T& key) {
+    return Iterator(_descend(key, false)->next[0]);
+  }
 
-      // Set back pointers
-      path[0]->next[0]->back = sn;
-      sn->back = path[0];
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::ConstIterator Map<Key_T, Mapped_T>::lower_bound(const Key_T& key) const {
+    return ConstIterator(_descend(key, false)->next[0]);
+  }
 
-      // Set next pointers
-      for (int i = 0; i < copy_height; i++) {
-        sn->next[i] = path[i]->next[i];
-        path[i]->next[i] = sn;
-      }
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::upper_bound(const Key_T& key) {
+    return Iterator(_descend(key, true)->next[0]);
+  }
 
-      _size++;
-      return std::make_pair(Iterator(sn), true);
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::ConstIterator Map<Key_T, Mapped_T>::upper_bound(const Key_T& key) const {
+    return ConstIterator(_descend(key, true)->next[0]);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename Map<Key_T, Mapped_T>::Iterator, typename Map<Key_T, Mapped_T>::Iterator>
+  Map<Key_T, Mapped_T>::equal_range(const Key_T& key) {
+    // Keys are unique so it's one descent and at most one step
+    SkipNode *it = _descend(key, false)->next[0];
+    if (_matches(it, key)) {
+      return std::make_pair(Iterator(it), Iterator(it->next[0]));
+    }
+    return std::make_pair(Iterator(it), Iterator(it));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename Map<Key_T, Mapped_T>::ConstIterator, typename Map<Key_T, Mapped_T>::ConstIterator>
+  Map<Key_T, Mapped_T>::equal_range(const Key_T& key) const {
+    const SkipNode *it = _descend(key, false)->next[0];
+    if (_matches(it, key)) {
+      return std::make_pair(ConstIterator(it), ConstIterator(it->next[0]));
     }
+    return std::make_pair(ConstIterator(it), ConstIterator(it));
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename Map<Key_T, Mapped_T>::Iterator, bool> Map<Key_T, Mapped_T>::insert(const ValueType& val) {
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _search(val.first, path, pos);
+
+    SkipNode *it = path[0]->next[0];
+    if (_matches(it, val.first)) {
+      _set_finger(path, pos);
+      return std::make_pair(Iterator(it), false);
+    }
+
+    return std::make_pair(Iterator(_link(_new_node(_levels(), val), path, pos)), true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  std::pair<typename Map<Key_T, Mapped_T>::Iterator, bool> Map<Key_T, Mapped_T>::insert(ValueType&& val) {
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _search(val.first, path, pos);
+
+    SkipNode *it = path[0]->next[0];
+    if (_matches(it, val.first)) {
+      _set_finger(path, pos);
+      return std::make_pair(Iterator(it), false);
+    }
+
+    return std::make_pair(Iterator(_link(_new_node(_levels(), std::move(val)), path, pos)), true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename... Args>
+  std::pair<typename Map<Key_T, Mapped_T>::Iterator, bool> Map<Key_T, Mapped_T>::emplace(Args&&... args) {
+    // No key to search for until the value exists
+    SkipNode *sn = _new_node(_levels(), std::forward<Args>(args)...);
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _search(sn->data()->first, path, pos);
+
+    SkipNode *it = path[0]->next[0];
+    if (_matches(it, sn->data()->first)) {
+      _free_node(sn);
+      _set_finger(path, pos);
+      return std::make_pair(Iterator(it), false);
+    }
+
+    return std::make_pair(Iterator(_link(sn, path, pos)), true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename... Args>
+  std::pair<typename Map<Key_T, Mapped_T>::Iterator, bool> Map<Key_T, Mapped_T>::try_emplace(const Key_T& key, Args&&... args) {
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _search(key, path, pos);
+
+    SkipNode *it = path[0]->next[0];
+    if (_matches(it, key)) {
+      _set_finger(path, pos);
+      return std::make_pair(Iterator(it), false);
+    }
+
+    SkipNode *sn = _new_node(_levels(), std::piecewise_construct, std::forward_as_tuple(key),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(Iterator(_link(sn, path, pos)), true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename... Args>
+  std::pair<typename Map<Key_T, Mapped_T>::Iterator, bool> Map<Key_T, Mapped_T>::try_emplace(Key_T&& key, Args&&... args) {
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _search(key, path, pos);
+
+    SkipNode *it = path[0]->next[0];
+    if (_matches(it, key)) {
+      _set_finger(path, pos);
+      return std::make_pair(Iterator(it), false);
+    }
+
+    SkipNode *sn = _new_node(_levels(), std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(Iterator(_link(sn, path, pos)), true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::insert(Iterator hint, const ValueType& val) {
+    SkipNode *after = hint._it;
+    SkipNode *before = after->back;
+    if (!_before(before, val.first) || (after != _sentinel && !_cmp(val.first, after->data()->first))) {
+      return insert(val).first;
+    }
+
+    // val goes right in front of after, so after's predecessors are the
+    // path. Hinting in order leaves the finger sitting on them already,
+    // anywhere else they come off the back links without comparing keys.
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    if (_finger[0]->next[0] == after) {
+      std::copy(_finger, _finger + MAX_SKIP_LIST_HEIGHT, path);
+      std::copy(_finger_pos, _finger_pos + MAX_SKIP_LIST_HEIGHT, pos);
+    } else {
+      _path_to(after, path, pos);
+    }
+    return Iterator(_link(_new_node(_levels(), val), path, pos));
   }
 
   template <typename Key_T, typename Mapped_T>
   template <typename IT_T>
   void Map<Key_T, Mapped_T>::insert(IT_T range_beg, IT_T range_end) {
+    // Anything past the current max gets tacked onto the end of every level
+    // without a search, so sorted input loads in one pass. Out of order
+    // elements fall back to a normal insert, which never moves the last node
+    // on a level that already had one.
+    SkipNode *lasts[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _find_lasts(lasts, pos);
     for (auto it = range_beg; it != range_end; it++) {
-      insert(*it);
+      // Forwarded so move iterators move
+      auto&& val = *it;
+      SkipNode *tail = _sentinel->back;
+      if (tail == _head || _cmp(tail->data()->first, val.first)) {
+        _append(std::forward<decltype(val)>(val), lasts, pos);
+      } else {
+        // The finger went stale while we were appending, lasts is current
+        _set_finger(lasts, pos);
+        if (insert(std::forward<decltype(val)>(val)).second) {
+          // Tails might have shifted over or a new level might have appeared
+          _find_lasts(lasts, pos);
+        }
+      }
+    }
+    _set_finger(lasts, pos);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_path_to(SkipNode *sn, SkipNode **path, size_t *pos) {
+    // dist[i] is how far path[i] is behind sn. Below sn's height that's just
+    // the width of the link into sn, above it walk back along the level
+    // underneath until something is tall enough, adding up the links passed.
+    size_t dist[MAX_SKIP_LIST_HEIGHT];
+    SkipNode *p = _head;
+    for (int i = 0; i < sn->height; i++) {
+      p = path[i] = sn->prev(i);
+      dist[i] = p->width()[i];
+    }
+    for (int i = sn->height; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      dist[i] = dist[i - 1];
+      while (p->height <= i) {
+        p = p->prev(i - 1);
+        // p is at least i tall, and the walk only goes on past it when it's
+        // exactly i, so the width and prev it needs can be fetched at the
+        // same time as its height. Overlapping those misses is what keeps
+        // this ahead of a key search.
+        __builtin_prefetch(p->next + 2 * i - 1);
+        __builtin_prefetch(p->next + 3 * i - 2);
+        dist[i] += p->width()[i - 1];
+      }
+      path[i] = p;
+    }
+    // The top of the path is _head at position 0 unless sn is full height
+    size_t sn_pos = dist[MAX_SKIP_LIST_HEIGHT - 1];
+    while (p != _head) {
+      p = p->prev(MAX_SKIP_LIST_HEIGHT - 1);
+      sn_pos += p->width()[MAX_SKIP_LIST_HEIGHT - 1];
+    }
+    for (int i = 0; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      pos[i] = sn_pos - dist[i];
     }
   }
 
   template <typename Key_T, typename Mapped_T>
-  void Map<Key_T, Mapped_T>::erase(Iterator pos) {
+  void Map<Key_T, Mapped_T>::_unlink(SkipNode *target, SkipNode **path, size_t *pos) {
+    // Forward the prev's nexts to target's nexts, the links get one shorter
+    int target_height = target->height;
+    for (int i = 0; i < target_height; i++) {
+      path[i]->next[i] = target->next[i];
+      target->next[i]->prev(i) = path[i];
+      path[i]->width()[i] += target->width()[i] - 1;
+    }
+    for (int i = target_height; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      path[i]->width()[i]--;
+    }
+    // Everything in path comes before target so it all survives
+    _set_finger(path, pos);
+
+    // Kill target
+    _free_node(target);
+    _size--;
+    _shrink_height();
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::erase(Iterator it) {
     // What if if pos == end?
-    if (pos == end()) {
+    if (it == end()) {
       // Eh, stop it I guess?
       return;
     }
 
-    // lazy af
-    // this could probably be an O(1) op if only every Node had every back pointer
-    erase(pos->first);
+    // We already have the node, all we need is its predecessors. If the
+    // finger is sitting right in front of it that's free, otherwise walk the
+    // back links, which never looks at a key.
+    SkipNode *target = it._it;
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    if (_finger[0]->next[0] == target) {
+      std::copy(_finger, _finger + MAX_SKIP_LIST_HEIGHT, path);
+      std::copy(_finger_pos, _finger_pos + MAX_SKIP_LIST_HEIGHT, pos);
+    } else {
+      _path_to(target, path, pos);
+    }
+    _unlink(target, path, pos);
   }
 
   template <typename Key_T, typename Mapped_T>
   void Map<Key_T, Mapped_T>::erase(const Key_T& key) {
-    // This operation could use find() if SkipNodes had matching back pointers
-    // But we really need the path vector
-    // Also pray that find actually works or I'm going to have to fix every instance
-    // of it that I copied into insert and erase
-    int level;
-    SkipNode *it = _head;
-    std::vector<SkipNode *> path(_height, _sentinel);
-    for (level = _height - 1; level >= 0; level--) {
-      while (it->next[level] != _sentinel && it->next[level]->data->first < key) {
-        it = it->next[level];
+    _erase_key(key);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  template <typename K>
+  void Map<Key_T, Mapped_T>::_erase_key(const K& key) {
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _search(key, path, pos);
+
+    SkipNode *target = path[0]->next[0];
+    if (!_matches(target, key)) {
+      throw std::out_of_range("Key not found");
+    }
+    _unlink(target, path, pos);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  typename Map<Key_T, Mapped_T>::Iterator Map<Key_T, Mapped_T>::erase(Iterator first, Iterator last) {
+    if (first == last || first == end()) {
+      return last;
+    }
+
+    SkipNode *path[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    _path_to(first._it, path, pos);
+
+    size_t k = 0;
+    for (SkipNode *it = first._it; it != last._it; it = it->next[0]) {
+      k++;
+    }
+    size_t last_pos = pos[0] + 1 + k;
+
+    // On every level, jump path[i] over whatever part of the run is there
+    for (int i = 0; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      SkipNode *y = path[i]->next[i];
+      size_t y_pos = pos[i] + path[i]->width()[i];
+      while (y_pos < last_pos) {
+        y_pos += y->width()[i];
+        y = y->next[i];
       }
-      path[level] = it;
+      path[i]->next[i] = y;
+      path[i]->width()[i] = y_pos - pos[i] - k;
+      y->prev(i) = path[i];
     }
 
-    SkipNode *target = it->next[0];
-    if (target == _sentinel || !(target->data->first == key)) {
-      throw std::out_of_range("Key not found");
+    SkipNode *it = first._it;
+    while (it != last._it) {
+      SkipNode *t = it->next[0];
+      _free_node(it);
+      it = t;
     }
+    _size -= k;
+    _set_finger(path, pos);
+    _shrink_height();
 
-    // Adjust target's next back pointer
-    target->next[0]->back = it;
+    return last;
+  }
 
-    // Forward the prev's nexts to target's nexts
-    int target_height = target->next.size();
-    for (int i = 0; i < target_height; i++) {
-      path[i]->next[i] = target->next[i];
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_link_last(SkipNode *sn, size_t sn_pos, SkipNode **lasts, size_t *pos) {
+    for (int i = 0; i < sn->height; i++) {
+      lasts[i]->next[i] = sn;
+      lasts[i]->width()[i] = sn_pos - pos[i];
+      sn->prev(i) = lasts[i];
+      lasts[i] = sn;
+      pos[i] = sn_pos;
     }
+  }
 
-    // Kill target
-    delete target;
-    _size--;
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::_close_lasts(SkipNode **lasts, size_t *pos) {
+    for (int i = 0; i < MAX_SKIP_LIST_HEIGHT; i++) {
+      lasts[i]->next[i] = _sentinel;
+      lasts[i]->width()[i] = _size + 1 - pos[i];
+      _sentinel->prev(i) = lasts[i];
+    }
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T> Map<Key_T, Mapped_T>::_set_op(const Map& other, bool mine, bool both, bool theirs) const {
+    Map result(_levels);
+    SkipNode *lasts[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    result._find_lasts(lasts, pos);
+
+    // Stop once neither side can add anything more
+    const SkipNode *a = _head->next[0];
+    const SkipNode *b = other._head->next[0];
+    while ((a != _sentinel && b != other._sentinel) || (mine && a != _sentinel) || (theirs && b != other._sentinel)) {
+      int c = a == _sentinel ? 1 : b == other._sentinel ? -1 : _compare_keys(a->data()->first, b->data()->first);
+      if (c < 0) {
+        if (mine) {
+          result._append(*a->data(), lasts, pos);
+        }
+        a = a->next[0];
+      } else if (c > 0) {
+        if (theirs) {
+          result._append(*b->data(), lasts, pos);
+        }
+        b = b->next[0];
+      } else {
+        if (both) {
+          result._append(*a->data(), lasts, pos);
+        }
+        a = a->next[0];
+        b = b->next[0];
+      }
+    }
+    return result;
+  }
 
-    // TODO Maybe readjust _height if we just deleted the last of the tallest height
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T> Map<Key_T, Mapped_T>::unite(const Map& other) const {
+    return _set_op(other, true, true, true);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T> Map<Key_T, Mapped_T>::intersect(const Map& other) const {
+    return _set_op(other, false, true, false);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  Map<Key_T, Mapped_T> Map<Key_T, Mapped_T>::subtract(const Map& other) const {
+    return _set_op(other, true, false, false);
+  }
+
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::merge(Map& other) {
+    if (&other == this || other._size == 0) {
+      return;
+    }
+    _pool.adopt(other._pool);
+
+    // Interleave both level 0 lists, every node keeps its own tower. Reading
+    // a->next[0] before relinking is enough, nothing looks at the old upper
+    // levels again. Other's copies of keys we have get chained up on next[0].
+    SkipNode *lasts[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    std::fill(lasts, lasts + MAX_SKIP_LIST_HEIGHT, _head);
+    std::fill(pos, pos + MAX_SKIP_LIST_HEIGHT, 0);
+    SkipNode *a = _head->next[0];
+    SkipNode *b = other._head->next[0];
+    SkipNode *dups = nullptr;
+    SkipNode **dups_tail = &dups;
+    size_t n = 0;
+    while (a != _sentinel || b != other._sentinel) {
+      int c = a == _sentinel ? 1 : b == other._sentinel ? -1 : _compare_keys(a->data()->first, b->data()->first);
+      SkipNode *sn;
+      if (c <= 0) {
+        sn = a;
+        a = a->next[0];
+        if (c == 0) {
+          *dups_tail = b;
+          dups_tail = &b->next[0];
+          b = b->next[0];
+        }
+      } else {
+        sn = b;
+        b = b->next[0];
+      }
+      _link_last(sn, ++n, lasts, pos);
+    }
+    *dups_tail = nullptr;
+    _size = n;
+    _close_lasts(lasts, pos);
+    _height = std::max(_height, other._height);
+    std::fill(_finger, _finger + MAX_SKIP_LIST_HEIGHT, _head);
+    std::fill(_finger_pos, _finger_pos + MAX_SKIP_LIST_HEIGHT, 0);
+
+    // Other starts over in its now empty pool with just the leftovers, their
+    // old blocks are ours now
+    _pool.deallocate(0, other._head);
+    _pool.deallocate(0, other._sentinel);
+    other._height = 1;
+    other._head = other._new_link_node();
+    other._sentinel = other._new_link_node();
+    other._size = 0;
+    other._init_skip_list();
+    other._find_lasts(lasts, pos);
+    while (dups != nullptr) {
+      SkipNode *t = dups->next[0];
+      other._append(std::move(*dups->data()), lasts, pos);
+      _free_node(dups);
+      dups = t;
+    }
   }
 
   template <typename Key_T, typename Mapped_T>
   void Map<Key_T, Mapped_T>::clear() {
-    // Assuming operator= works this should be fine
-    *this = Map<Key_T, Mapped_T>();
+    // Start over in place so the level generator survives
+    _delete_skip_list();
+    _height = 1;
+    _head = _new_link_node();
+    _sentinel = _new_link_node();
+    _size = 0;
+    _init_skip_list();
   }
 
+  template <typename Key_T, typename Mapped_T>
+  void Map<Key_T, Mapped_T>::rebalance() {
+    // Appending in order gives out the balanced heights by position, same as
+    // a bulk load, and the old nodes go away with tmp
+    Map tmp(_levels);
+    tmp._cmp = _cmp;
+    SkipNode *lasts[MAX_SKIP_LIST_HEIGHT];
+    size_t pos[MAX_SKIP_LIST_HEIGHT];
+    tmp._find_lasts(lasts, pos);
+    for (SkipNode *it = _head->next[0]; it != _sentinel; it = it->next[0]) {
+      tmp._append(std::move(*it->data()), lasts, pos);
+    }
+    tmp._set_finger(lasts, pos);
+    _swap(tmp);
+  }
 
 }
 
@@ -0,0 +1,356 @@
+#ifndef _WORKLOAD_H_
+#define _WORKLOAD_H_
+
+// YCSB style workloads for the string keyed maps. A Workload is a set of
+// keys to load up front plus a pregenerated list of operations, so making
+// up keys never gets timed along with the map. Anything with find,
+// insert, erase(Iterator) and lower_bound can be driven with load and run.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cs540 {
+  namespace workload {
+    enum class Distribution {
+      UNIFORM,
+      // Popular keys get most of the traffic, spread over the key space
+      ZIPF,
+      // Same skew, but the popular keys are the newest ones
+      LATEST
+    };
+
+    struct Spec {
+      // Keys loaded before the clock starts
+      size_t records = 100000;
+      size_t ops = 100000;
+      Distribution distribution = Distribution::ZIPF;
+      // Skew for ZIPF and LATEST, 0.99 is YCSB's default. Has to be in (0, 1).
+      double theta = 0.99;
+      // Fraction of reads and scans aimed at a key that's there
+      double hit_ratio = 0.7;
+      // Keys never come out shorter than 20 bytes, which is what it takes to
+      // keep them unique
+      size_t key_size = 24;
+      size_t value_size = 100;
+      // Op mix, only the proportions matter
+      double read = 90;
+      double insert = 5;
+      double erase = 3;
+      double scan = 2;
+      size_t scan_length = 50;
+      uint64_t seed = 1;
+    };
+
+    // Reads "dist=zipf,theta=0.99,hit=0.7,key=24,value=100,read=90,insert=5,
+    // erase=3,scan=2,scan_length=50,records=100000,ops=100000,seed=1",
+    // anything left out keeps its default
+    inline Spec parse_spec(const std::string& text) {
+      Spec spec;
+      std::stringstream ss(text);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+          throw std::invalid_argument("expected name=value in workload spec, got " + item);
+        }
+        std::string name = item.substr(0, eq);
+        std::string value = item.substr(eq + 1);
+        double num = std::atof(value.c_str());
+        if (name == "dist") {
+          if (value == "uniform") {
+            spec.distribution = Distribution::UNIFORM;
+          } else if (value == "zipf") {
+            spec.distribution = Distribution::ZIPF;
+          } else if (value == "latest") {
+            spec.distribution = Distribution::LATEST;
+          } else {
+            throw std::invalid_argument("unknown distribution " + value);
+          }
+        } else if (name == "theta") {
+          spec.theta = num;
+        } else if (name == "hit") {
+          spec.hit_ratio = num;
+        } else if (name == "key") {
+          spec.key_size = static_cast<size_t>(num);
+        } else if (name == "value") {
+          spec.value_size = static_cast<size_t>(num);
+        } else if (name == "read") {
+          spec.read = num;
+        } else if (name == "insert") {
+          spec.insert = num;
+        } else if (name == "erase") {
+          spec.erase = num;
+        } else if (name == "scan") {
+          spec.scan = num;
+        } else if (name == "scan_length") {
+          spec.scan_length = static_cast<size_t>(num);
+        } else if (name == "records") {
+          spec.records = static_cast<size_t>(num);
+        } else if (name == "ops") {
+          spec.ops = static_cast<size_t>(num);
+        } else if (name == "seed") {
+          spec.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+          throw std::invalid_argument("unknown workload setting " + name);
+        }
+      }
+      return spec;
+    }
+
+    // Zipf over [0, n) the way YCSB does it (Gray et al., "Quickly
+    // Generating Billion-Record Synthetic Databases"). Setting up is O(n),
+    // every draw after that is O(1).
+    class ZipfGenerator {
+    public:
+      ZipfGenerator(uint64_t n, double theta);
+      template <typename Engine>
+      uint64_t operator()(Engine&);
+
+    private:
+      uint64_t _n;
+      double _theta;
+      double _zetan;
+      double _alpha;
+      double _eta;
+    };
+
+    inline ZipfGenerator::ZipfGenerator(uint64_t n, double theta):
+      _n(n),
+      _theta(theta),
+      _zetan(0),
+      _alpha(1 / (1 - theta)),
+      _eta(0) {
+      if (!(theta > 0 && theta < 1)) {
+        throw std::invalid_argument("zipf theta has to be in (0, 1)");
+      }
+      if (n == 0) {
+        throw std::invalid_argument("zipf needs at least one item");
+      }
+      for (uint64_t i = 1; i <= n; i++) {
+        _zetan += 1 / std::pow(static_cast<double>(i), theta);
+      }
+      double zeta2 = 1 + 1 / std::pow(2.0, theta);
+      _eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / _zetan);
+    }
+
+    template <typename Engine>
+    uint64_t ZipfGenerator::operator()(Engine& engine) {
+      double u = std::uniform_real_distribution<double>(0, 1)(engine);
+      double uz = u * _zetan;
+      if (uz < 1) {
+        return 0;
+      }
+      if (uz < 1 + std::pow(0.5, _theta)) {
+        return std::min<uint64_t>(1, _n - 1);
+      }
+      uint64_t r = static_cast<uint64_t>(_n * std::pow(_eta * u - _eta + 1, _alpha));
+      return std::min(r, _n - 1);
+    }
+
+    enum class OpType { READ, INSERT, ERASE, SCAN };
+
+    struct Operation {
+      OpType type;
+      std::string key;
+    };
+
+    class Workload {
+    public:
+      explicit Workload(const Spec&);
+
+      const Spec& spec() const { return _spec; }
+      // In random order, so loading isn't a sorted bulk insert
+      const std::vector<std::string>& load_keys() const { return _load; }
+      const std::vector<Operation>& ops() const { return _ops; }
+      // Every insert puts in a copy of this
+      const std::string& value() const { return _value; }
+
+      // Ids go through a bijective mix first, so neighbouring ids, and with
+      // them the popular keys, end up all over the key space like YCSB's
+      // hashed keys
+      static std::string make_key(uint64_t id, size_t size);
+
+    private:
+      Spec _spec;
+      std::vector<std::string> _load;
+      std::vector<Operation> _ops;
+      std::string _value;
+    };
+
+    inline std::string Workload::make_key(uint64_t id, size_t size) {
+      uint64_t x = id;
+      x ^= x >> 33;
+      x *= 0xff51afd7ed558ccdull;
+      x ^= x >> 33;
+      x *= 0xc4ceb9fe1a85ec53ull;
+      x ^= x >> 33;
+      static const char hex[] = "0123456789abcdef";
+      std::string key = "user";
+      for (int shift = 60; shift >= 0; shift -= 4) {
+        key += hex[(x >> shift) & 0xf];
+      }
+      if (key.size() < size) {
+        key.resize(size, '.');
+      }
+      return key;
+    }
+
+    inline Workload::Workload(const Spec& spec): _spec(spec) {
+      double total = spec.read + spec.insert + spec.erase + spec.scan;
+      if (!(total > 0) || spec.read < 0 || spec.insert < 0 || spec.erase < 0 || spec.scan < 0) {
+        throw std::invalid_argument("workload op mix has to be non negative and add up to something");
+      }
+      if (spec.records == 0) {
+        throw std::invalid_argument("workload needs at least one record");
+      }
+
+      std::mt19937_64 engine(spec.seed);
+      _value.resize(spec.value_size);
+      for (char& c: _value) {
+        c = static_cast<char>('a' + engine() % 26);
+      }
+
+      // Ids [0, records) get loaded, inserts hand out the ones after that,
+      // and misses come from way up where nothing ever gets inserted
+      std::vector<uint64_t> ids(spec.records);
+      for (uint64_t i = 0; i < spec.records; i++) {
+        ids[i] = i;
+      }
+      std::shuffle(ids.begin(), ids.end(), engine);
+      _load.reserve(spec.records);
+      for (uint64_t id: ids) {
+        _load.push_back(make_key(id, spec.key_size));
+      }
+
+      std::unique_ptr<ZipfGenerator> zipf;
+      if (spec.distribution != Distribution::UNIFORM) {
+        zipf.reset(new ZipfGenerator(spec.records, spec.theta));
+      }
+      std::uniform_real_distribution<double> coin(0, 1);
+      uint64_t next_id = spec.records;
+      const uint64_t miss_base = 1ull << 62;
+      // Erases take back what the run inserted, oldest first, so the loaded
+      // keys stay put and the hit ratio holds. Only once there's none of
+      // those left do they start on loaded keys.
+      std::deque<uint64_t> inserted;
+
+      auto existing = [&]() -> uint64_t {
+        if (spec.distribution == Distribution::UNIFORM) {
+          return std::uniform_int_distribution<uint64_t>(0, spec.records - 1)(engine);
+        }
+        uint64_t rank = (*zipf)(engine);
+        if (spec.distribution == Distribution::LATEST) {
+          // Newest first, out of the loaded ids and whatever got inserted since
+          return next_id - 1 - std::min(rank, next_id - 1);
+        }
+        return rank;
+      };
+      auto target = [&]() -> uint64_t {
+        if (coin(engine) < spec.hit_ratio) {
+          return existing();
+        }
+        return miss_base + std::uniform_int_distribution<uint64_t>(0, miss_base - 1)(engine);
+      };
+
+      _ops.reserve(spec.ops);
+      for (size_t i = 0; i < spec.ops; i++) {
+        double pick = coin(engine) * total;
+        Operation op;
+        uint64_t id;
+        if (pick < spec.read) {
+          op.type = OpType::READ;
+          id = target();
+        } else if (pick < spec.read + spec.insert) {
+          op.type = OpType::INSERT;
+          id = next_id++;
+          inserted.push_back(id);
+        } else if (pick < spec.read + spec.insert + spec.erase) {
+          op.type = OpType::ERASE;
+          if (!inserted.empty()) {
+            id = inserted.front();
+            inserted.pop_front();
+          } else {
+            id = existing();
+          }
+        } else {
+          op.type = OpType::SCAN;
+          id = target();
+        }
+        op.key = make_key(id, spec.key_size);
+        _ops.push_back(std::move(op));
+      }
+    }
+
+    struct Stats {
+      size_t reads = 0;
+      size_t hits = 0;
+      size_t inserts = 0;
+      size_t erases = 0;
+      size_t scans = 0;
+      // Elements visited by scans
+      size_t scanned = 0;
+      // Adds up value sizes so nothing gets optimized out
+      size_t bytes = 0;
+    };
+
+    template <typename M>
+    void load(M& map, const Workload& w) {
+      for (const std::string& key: w.load_keys()) {
+        map.insert(std::make_pair(key, w.value()));
+      }
+    }
+
+    template <typename M>
+    Stats run(M& map, const Workload& w) {
+      Stats stats;
+      const size_t scan_length = w.spec().scan_length;
+      for (const Operation& op: w.ops()) {
+        switch (op.type) {
+        case OpType::READ: {
+          stats.reads++;
+          auto it = map.find(op.key);
+          if (it != map.end()) {
+            stats.hits++;
+            stats.bytes += it->second.size();
+          }
+          break;
+        }
+        case OpType::INSERT:
+          stats.inserts++;
+          map.insert(std::make_pair(op.key, w.value()));
+          break;
+        case OpType::ERASE: {
+          auto it = map.find(op.key);
+          if (it != map.end()) {
+            stats.erases++;
+            map.erase(it);
+          }
+          break;
+        }
+        case OpType::SCAN: {
+          stats.scans++;
+          auto it = map.lower_bound(op.key);
+          for (size_t k = 0; k < scan_length && it != map.end(); k++, ++it) {
+            stats.scanned++;
+            stats.bytes += it->second.size();
+          }
+          break;
+        }
+        }
+      }
+      return stats;
+    }
+  }
+}
+
+#endif
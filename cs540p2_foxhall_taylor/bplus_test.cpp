@@ -0,0 +1,184 @@
+// Compile with -std=c++11
+//
+// Runs BPlusMap against std::map through random inserts and erases, for key
+// types that give wide nodes and for ones that give the narrowest possible,
+// so splits, merges and borrowing all get exercised at every level.
+
+#include "BPlusMap.hpp"
+#include <assert.h>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+
+// Big and not assignable, nodes bottom out at 4 slots
+struct Wide {
+  Wide(int k): key(k) {}
+  friend bool operator<(const Wide& w1, const Wide& w2) {
+    return w1.key < w2.key;
+  }
+  friend bool operator==(const Wide& w1, const Wide& w2) {
+    return w1.key == w2.key;
+  }
+  Wide& operator=(const Wide&) = delete;
+  const int key;
+  char pad[200];
+};
+
+template <typename K, typename V>
+void check_against(const cs540::BPlusMap<K, V>& m, const std::map<K, V>& mirror) {
+  assert(m.size() == mirror.size() && m.empty() == mirror.empty());
+  auto it = m.begin();
+  for (auto& kv: mirror) {
+    assert(it != m.end() && it->first == kv.first && it->second == kv.second);
+    ++it;
+  }
+  assert(it == m.end());
+  // And back down again
+  for (auto rit = mirror.rbegin(); rit != mirror.rend(); ++rit) {
+    --it;
+    assert(it->first == rit->first);
+  }
+  assert(it == m.begin());
+}
+
+template <typename K>
+void random_ops(K (*make)(int), int ops, int range) {
+  typedef cs540::BPlusMap<K, int> Tree;
+  Tree m;
+  std::map<K, int> mirror;
+  std::mt19937 gen(7);
+  for (int i = 0; i < ops; i++) {
+    K k = make(gen() % range);
+    int op = gen() % 10;
+    if (op < 5) {
+      auto res = m.insert(std::make_pair(k, i));
+      auto mres = mirror.insert(std::make_pair(k, i));
+      assert(res.second == mres.second && res.first->first == k && res.first->second == mres.first->second);
+    } else if (op < 8) {
+      bool there = mirror.erase(k) == 1;
+      bool threw = false;
+      try {
+        m.erase(k);
+      } catch (const std::out_of_range&) {
+        threw = true;
+      }
+      assert(threw == !there);
+    } else if (op < 9) {
+      auto it = m.lower_bound(k);
+      auto mit = mirror.lower_bound(k);
+      assert(mit == mirror.end() ? it == m.end() : it->first == mit->first);
+      if (it != m.end()) {
+        m.erase(it);
+        mirror.erase(mit);
+      }
+    } else {
+      auto it = m.upper_bound(k);
+      auto mit = mirror.upper_bound(k);
+      assert(mit == mirror.end() ? it == m.end() : it->first == mit->first);
+      assert(m.count(k) == mirror.count(k));
+    }
+    if (i % 997 == 0) {
+      check_against(m, mirror);
+    }
+  }
+  check_against(m, mirror);
+
+  // Copies are deep, moves leave the source empty
+  Tree copy(m);
+  assert(copy == m && !(copy < m) && !(m < copy));
+  if (!mirror.empty()) {
+    copy.erase(mirror.begin()->first);
+    assert(copy != m && m < copy);
+    check_against(m, mirror);
+  }
+  Tree moved(std::move(copy));
+  assert(copy.empty() && copy.begin() == copy.end());
+  copy = m;
+  assert(copy == m);
+  moved = std::move(copy);
+  assert(moved == m);
+
+  // Empty it out completely, the tree shrinks back to one leaf
+  while (!mirror.empty()) {
+    auto key = mirror.rbegin()->first;
+    m.erase(key);
+    mirror.erase(key);
+  }
+  check_against(m, mirror);
+  m.insert(std::make_pair(make(1), 1));
+  assert(m.size() == 1 && m.begin()->second == 1);
+  m.clear();
+  assert(m.empty() && m.find(make(1)) == m.end());
+}
+
+int make_int(int i) {
+  return i;
+}
+std::string make_string(int i) {
+  return "key" + std::to_string(i);
+}
+Wide make_wide(int i) {
+  return Wide(i);
+}
+
+void test_basics() {
+  cs540::BPlusMap<int, std::string> m{{3, "c"}, {1, "a"}, {2, "b"}};
+  assert(m.size() == 3 && m.at(2) == "b");
+  m[4] = "d";
+  m[1] += "a";
+  assert(m.at(1) == "aa" && m.size() == 4);
+  bool threw = false;
+  try {
+    m.at(5);
+  } catch (const std::out_of_range&) {
+    threw = true;
+  }
+  assert(threw);
+
+  auto put = m.try_emplace(5, 3, 'e');
+  assert(put.second && put.first->second == "eee");
+  put = m.try_emplace(5, "nope");
+  assert(!put.second && put.first->second == "eee");
+
+  std::string back;
+  for (auto rit = m.rbegin(); rit != m.rend(); ++rit) {
+    back += std::to_string(rit->first);
+  }
+  assert(back == "54321");
+
+  const auto& cm = m;
+  cs540::BPlusMap<int, std::string>::ConstIterator cit = m.begin();
+  assert(cit == cm.begin() && cm.find(3)->second == "c" && cm.lower_bound(6) == cm.end());
+}
+
+void test_ascending() {
+  // The sequential split keeps leaves full, and the map still works after
+  // scattered erases chew into them
+  cs540::BPlusMap<int, int> m;
+  std::map<int, int> mirror;
+  for (int i = 0; i < 100000; i++) {
+    m.insert(std::make_pair(i, i));
+    mirror.insert(std::make_pair(i, i));
+  }
+  check_against(m, mirror);
+  for (int i = 0; i < 100000; i += 3) {
+    m.erase(i);
+    mirror.erase(i);
+  }
+  check_against(m, mirror);
+  for (int i = 100000; i > 0; i -= 2) {
+    m[i] = i;
+    mirror[i] = i;
+  }
+  check_against(m, mirror);
+}
+
+int main() {
+  test_basics();
+  test_ascending();
+  random_ops<int>(make_int, 200000, 5000);
+  random_ops<std::string>(make_string, 100000, 3000);
+  random_ops<Wide>(make_wide, 50000, 1000);
+  std::cout << "BPlusMap checks passed" << std::endl;
+}
@@ -0,0 +1,177 @@
+// Compile with -std=c++11 -O2 -pthread
+//
+// Pits ConcurrentMap against Map behind one big lock (what we do today) on a
+// read heavy and a write heavy mix, for a growing number of threads.
+
+#include "ConcurrentMap.hpp"
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace cs540 {
+  // Map with a global lock, the baseline
+  template <typename K, typename V>
+  class LockedMap {
+  public:
+    bool find(const K& k) {
+      std::lock_guard<std::mutex> g(m_lock);
+      return m_map.find(k) != m_map.end();
+    }
+    void insert(const std::pair<const K, V>& val) {
+      std::lock_guard<std::mutex> g(m_lock);
+      m_map.insert(val);
+    }
+    bool remove(const K& k) {
+      std::lock_guard<std::mutex> g(m_lock);
+      auto it = m_map.find(k);
+      if (it == m_map.end()) return false;
+      m_map.erase(it);
+      return true;
+    }
+    size_t size() {
+      std::lock_guard<std::mutex> g(m_lock);
+      return m_map.size();
+    }
+
+  private:
+    std::mutex m_lock;
+    Map<K, V> m_map;
+  };
+
+  template <typename K, typename V>
+  class LockFreeMap {
+  public:
+    bool find(const K& k) { return m_map.find(k) != m_map.end(); }
+    void insert(const std::pair<const K, V>& val) { m_map.insert(val); }
+    bool remove(const K& k) { return m_map.remove(k); }
+    size_t size() { return m_map.size(); }
+
+  private:
+    ConcurrentMap<K, V> m_map;
+  };
+}
+
+const int KEY_RANGE = 1 << 20;
+const int OPS_PER_THREAD = 400000;
+
+struct Mix {
+  const char *name;
+  int find_pct;
+  int insert_pct; // Whatever's left over erases
+};
+
+template <typename M>
+double run(const Mix& mix, int nthreads) {
+  M map;
+  // Half full so inserts and erases both have something to do
+  for (int i = 0; i < KEY_RANGE; i += 2) {
+    map.insert({i, i});
+  }
+
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([&map, &mix, t]() {
+      std::mt19937 gen(t + 1);
+      std::uniform_int_distribution<int> key(0, KEY_RANGE - 1);
+      std::uniform_int_distribution<int> op(0, 99);
+      size_t hits = 0;
+      for (int i = 0; i < OPS_PER_THREAD; i++) {
+        int k = key(gen);
+        int o = op(gen);
+        if (o < mix.find_pct) {
+          hits += map.find(k);
+        } else if (o < mix.find_pct + mix.insert_pct) {
+          map.insert({k, k});
+        } else {
+          hits += map.remove(k);
+        }
+      }
+      volatile size_t sink = hits;
+      (void)sink;
+    });
+  }
+  for (auto& th: threads) {
+    th.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return nthreads * OPS_PER_THREAD / elapsed.count() / 1e6;
+}
+
+// Every thread inserts and erases its own keys on top of a shared range that
+// everyone fights over, then we check nothing got lost or duplicated
+void stress_check(int nthreads) {
+  cs540::ConcurrentMap<int, int> map;
+  const int per_thread = 20000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([&map, t]() {
+      std::mt19937 gen(t);
+      for (int i = 0; i < per_thread; i++) {
+        int mine = (t + 1) * 1000000 + i;
+        assert(map.insert({mine, mine}).second);
+        int shared = gen() % 1000;
+        if (gen() & 1) {
+          map.insert({shared, shared});
+        } else {
+          map.remove(shared);
+        }
+        // Others erase these under us, at hands back a copy so that's fine
+        try {
+          assert(map.at(gen() % 1000) < 1000);
+        } catch (const std::out_of_range&) {
+        }
+        if (i % 2) {
+          map.erase(mine);
+          assert(map.find(mine) == map.end());
+        } else {
+          assert(map.at(mine) == mine);
+        }
+      }
+    });
+  }
+  for (auto& th: threads) {
+    th.join();
+  }
+
+  size_t count = 0;
+  int prev = -1;
+  for (auto& kv: map) {
+    assert(kv.first > prev);
+    assert(kv.first == kv.second);
+    prev = kv.first;
+    count++;
+  }
+  assert(count == map.size());
+  for (int t = 0; t < nthreads; t++) {
+    for (int i = 0; i < per_thread; i++) {
+      int mine = (t + 1) * 1000000 + i;
+      assert((map.find(mine) != map.end()) == (i % 2 == 0));
+    }
+  }
+}
+
+int main() {
+  stress_check(4);
+  std::cout << "Stress check passed\n";
+
+  unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << "Hardware threads: " << hw << "\n";
+  std::cout << "Throughput in M ops/s\n";
+
+  const Mix mixes[] = {{"read heavy (90/5/5)", 90, 5}, {"write heavy (50/25/25)", 50, 25}};
+  for (const Mix& mix: mixes) {
+    std::cout << mix.name << "\n";
+    std::cout << std::setw(10) << "threads" << std::setw(14) << "locked Map" << std::setw(16) << "ConcurrentMap\n";
+    for (int n = 1; n <= 2 * int(hw) && n <= 16; n *= 2) {
+      std::cout << std::setw(10) << n << std::fixed << std::setprecision(2)
+                << std::setw(14) << run<cs540::LockedMap<int, int>>(mix, n)
+                << std::setw(15) << run<cs540::LockFreeMap<int, int>>(mix, n) << "\n";
+    }
+  }
+}
@@ -0,0 +1,170 @@
+// Compile with -std=c++11 -O2
+//
+// Checks FrozenMap against the Map it was written from, then compares
+// starting up from a table against rebuilding the Map by inserting.
+
+#include "FrozenMap.hpp"
+#include "Map.hpp"
+#include <assert.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char *TABLE = "frozen_test.table";
+
+typedef cs540::Map<std::string, std::string> StringMap;
+
+std::string make_key(int i) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "user:session:%08d", i);
+  return buf;
+}
+
+void check_table(const StringMap& m) {
+  cs540::FrozenMap::write(TABLE, m);
+  cs540::FrozenMap f(TABLE);
+  assert(f.size() == m.size() && f.empty() == m.empty());
+
+  // Same order, same bytes
+  auto fit = f.begin();
+  for (auto& kv: m) {
+    assert(fit != f.end());
+    assert(fit.key() == kv.first && fit.value().str() == kv.second);
+    assert((*fit).first == kv.first);
+    ++fit;
+  }
+  assert(fit == f.end());
+
+  for (auto& kv: m) {
+    assert(f.find(kv.first) != f.end() && f.at(kv.first).str() == kv.second);
+    assert(f.count(kv.first) == 1);
+    // Just past and just before every key, hits and misses both
+    std::string after = kv.first + '\0';
+    auto lb = f.lower_bound(after);
+    auto mlb = m.lower_bound(after);
+    assert(mlb == m.end() ? lb == f.end() : lb.key() == mlb->first);
+    auto ub = f.upper_bound(kv.first);
+    auto mub = m.upper_bound(kv.first);
+    assert(mub == m.end() ? ub == f.end() : ub.key() == mub->first);
+    std::string before = kv.first.substr(0, kv.first.size() - 1);
+    assert(f.count(before) == m.count(before));
+  }
+  assert(f.find("") == f.end() || m.count("") == 1);
+  bool threw = false;
+  try {
+    f.at("\xff\xff not a key");
+  } catch (const std::out_of_range&) {
+    threw = true;
+  }
+  assert(threw);
+}
+
+void correctness() {
+  StringMap m;
+  check_table(m);
+
+  m.insert(std::make_pair(std::string("only"), std::string()));
+  check_table(m);
+
+  // Long shared prefixes, embedded zeros, values of every size, enough to
+  // fill lots of blocks
+  std::mt19937 gen(3);
+  for (int i = 0; i < 20000; i++) {
+    std::string k = make_key(gen() % 100000);
+    if (i % 7 == 0) {
+      k += std::string(gen() % 300, 'x');
+    }
+    std::string v(gen() % (i % 100 == 0 ? 9000 : 40), '\0');
+    for (auto& c: v) {
+      c = static_cast<char>(gen());
+    }
+    m.insert(std::make_pair(k, v));
+  }
+  check_table(m);
+
+  // Out of order input gets turned away
+  std::vector<std::pair<std::string, std::string>> unsorted = {{"b", "1"}, {"a", "2"}};
+  bool threw = false;
+  try {
+    cs540::FrozenMap::write(TABLE, unsorted.begin(), unsorted.end());
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  assert(threw);
+
+  // So do files that aren't tables
+  {
+    std::ofstream junk(TABLE, std::ios::binary | std::ios::trunc);
+    junk << std::string(100, 'j');
+  }
+  threw = false;
+  try {
+    cs540::FrozenMap f(TABLE);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw);
+}
+
+template <typename F>
+double time_ms(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+void startup(int count) {
+  std::vector<std::pair<std::string, std::string>> rows;
+  for (int i = 0; i < count; i++) {
+    rows.push_back(std::make_pair(make_key(i), std::string(40, 'v')));
+  }
+  std::vector<std::string> lookups;
+  std::mt19937 gen(9);
+  for (int i = 0; i < 100000; i++) {
+    lookups.push_back(make_key(gen() % (2 * count)));
+  }
+
+  StringMap m;
+  double build = time_ms([&]() {
+    for (auto& r: rows) {
+      m.insert(r);
+    }
+  });
+  cs540::FrozenMap::write(TABLE, m);
+
+  size_t hits1 = 0, hits2 = 0;
+  double find_map = time_ms([&]() {
+    for (auto& k: lookups) {
+      hits1 += m.find(k) != m.end();
+    }
+  });
+  double open = 0, find_frozen = 0;
+  {
+    cs540::FrozenMap *f = nullptr;
+    open = time_ms([&]() { f = new cs540::FrozenMap(TABLE); });
+    find_frozen = time_ms([&]() {
+      for (auto& k: lookups) {
+        hits2 += f->count(k);
+      }
+    });
+    delete f;
+  }
+  assert(hits1 == hits2);
+
+  std::cout << count << " entries: inserting into a Map took " << build << " ms, opening the table took "
+            << open << " ms\n"
+            << "  100000 finds took " << find_map << " ms on the Map and " << find_frozen << " ms on the table\n";
+}
+
+int main() {
+  correctness();
+  std::cout << "FrozenMap checks passed\n";
+  startup(100000);
+  startup(1000000);
+  std::remove(TABLE);
+}
@@ -1,41 +1,788 @@
 #include "Map.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <map>
 #include <random>
+#include <set>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <vector>
 
 class A {
 public:
   A() = default;
   A(int xx): x(xx) {}
   friend bool operator==(const A& me, const A& other) { return me.x == other.x; }
-  friend bool operator==(const A& me, const A& other) { return me.x == other.x; }
 private:
   int x;
 };
 
-template class cs540::Map<std::string, std::string>;
+void test_rand_height() {
+  cs540::SkipLevelGenerator gen;
+  std::cout << "Max skip list height is: " << gen.max_height() << std::endl;
+  std::cout << "Here are some random heights (geometric distribution p = 1/2):\n";
+
+  std::cout << std::string(gen.max_height(), '-') << std::endl;
+  for (int i = 0; i < 50; i++) {
+    std::cout << std::string(gen(), '*') << std::endl;
+  }
+  std::cout << std::string(gen.max_height(), '-') << std::endl;
+}
+
+void test_level_generator() {
+  // Same seed, same heights
+  cs540::SkipLevelGenerator a(0.5, 0, 42), b(0.5, 0, 42);
+  for (int i = 0; i < 1000; i++) {
+    assert(a() == b());
+  }
+  a.seed(7);
+  b.seed(7);
+  assert(a() == b());
+
+  // Roughly the right fraction make it to level 2 for a few p's
+  for (double p: {0.5, 0.25, 0.3}) {
+    cs540::SkipLevelGenerator gen(p, 0, 1);
+    int tall = 0, n = 100000;
+    for (int i = 0; i < n; i++) {
+      int h = gen();
+      assert(h >= 1 && h <= cs540::MAX_SKIP_LIST_HEIGHT);
+      if (h > 1) tall++;
+    }
+    assert(std::abs(tall / double(n) - p) < 0.01);
+  }
 
-static const int MAX_SKIP_LIST_HEIGHT = 20;
-static const int seed = std::chrono::system_clock::now().time_since_epoch().count();
-static std::default_random_engine gen(seed);
-static std::geometric_distribution<int> dist(0.5);
+  // Height gets capped around log_{1/p}(expected size)
+  cs540::SkipLevelGenerator small(0.5, 1000, 3);
+  assert(small.max_height() == 11);
+  for (int i = 0; i < 100000; i++) {
+    assert(small() <= 11);
+  }
 
-int rand_height() {
-  return std::min(dist(gen)+1, MAX_SKIP_LIST_HEIGHT);
+  // Seeded maps behave identically
+  cs540::Map<int, int> m1(cs540::SkipLevelGenerator(0.25, 1 << 16, 99));
+  cs540::Map<int, int> m2(cs540::SkipLevelGenerator(0.25, 1 << 16, 99));
+  for (int i = 0; i < 1000; i++) {
+    m1.insert({i, i});
+    m2.insert({i, i});
+  }
+  assert(m1 == m2);
+  m1.clear();
+  assert(m1.empty() && m1.find(3) == m1.end());
 }
 
-void test_rand_height() {
-  std::cout << "Max skip list height is: " << MAX_SKIP_LIST_HEIGHT << std::endl;
-  std::cout << "Here are some random heights (geometric distribution p = 1/2):\n";
+void test_bulk_load() {
+  // Balanced heights: every 2^k-th element is k levels taller
+  cs540::SkipLevelGenerator gen;
+  assert(gen.balanced(1) == 1 && gen.balanced(2) == 2 && gen.balanced(12) == 3 && gen.balanced(1024) == 11);
+  cs540::SkipLevelGenerator quarter(0.3, 0, 1);
+  assert(quarter.balanced(3) == 2 && quarter.balanced(9) == 3 && quarter.balanced(4) == 1);
+
+  std::vector<std::pair<int, int>> sorted;
+  for (int i = 0; i < 10000; i++) {
+    sorted.push_back({2 * i, i});
+  }
+  cs540::Map<int, int> m;
+  m.insert(sorted.begin(), sorted.end());
+  assert(m.size() == 10000);
+
+  // Out of order, duplicate and appended elements all in one range
+  std::vector<std::pair<int, int>> mixed = {{5, 0}, {4, 0}, {19999, 0}, {19999, 1}, {-1, 0}, {20000, 0}, {20002, 0}};
+  m.insert(mixed.begin(), mixed.end());
+  assert(m.size() == 10000 + 5);
+  assert(m.at(4) == 2 && m.at(19999) == 0 && m.at(-1) == 0 && m.at(20002) == 0);
+
+  int prev = -2;
+  size_t n = 0;
+  for (auto& kv: m) {
+    assert(kv.first > prev);
+    prev = kv.first;
+    n++;
+  }
+  assert(n == m.size());
+  for (auto it = m.rbegin(); it != m.rend(); it++) {
+    n--;
+  }
+  assert(n == 0);
+
+  // Initializer list goes through the same path, unsorted is fine too
+  cs540::Map<int, int> il{{1, 1}, {3, 3}, {2, 2}, {3, 4}};
+  assert(il.size() == 3 && il.at(3) == 3);
+  for (int i = 0; i < 10000; i++) {
+    assert(m.find(2 * i) != m.end());
+  }
+}
+
+void test_finger_and_hint() {
+  // Walk all over the place so the finger has to climb both ways, and check
+  // against std::set the whole time
+  cs540::Map<int, int> m;
+  std::set<int> ref;
+  std::mt19937 gen(5);
+  int k = 0;
+  for (int i = 0; i < 50000; i++) {
+    k += int(gen() % 21) - 10;
+    if (gen() % 4 == 0 && ref.count(k)) {
+      m.erase(k);
+      ref.erase(k);
+    } else {
+      assert(m.insert({k, i}).second == ref.insert(k).second);
+    }
+  }
+  assert(m.size() == ref.size());
+  auto rit = ref.begin();
+  for (auto& kv: m) {
+    assert(kv.first == *rit++);
+  }
+
+  // Right hints go in right there, wrong ones still work
+  cs540::Map<int, int> h;
+  auto pos = h.end();
+  for (int i = 0; i < 1000; i++) {
+    pos = h.insert(h.end(), {i * 2, i});
+  }
+  for (int i = 999; i >= 0; i--) {
+    pos = h.insert(pos, {i * 2 + 1, i});
+    assert(pos->first == i * 2 + 1);
+  }
+  assert(h.insert(h.begin(), {5000, 0})->first == 5000);
+  assert(h.insert(h.find(7), {7, 100})->second == 3);
+  assert(h.size() == 2001);
+  int prev = -1;
+  for (auto& kv: h) {
+    assert(kv.first > prev);
+    prev = kv.first;
+  }
+}
+
+// Every position answers nth, rank and + k the same way std::set does
+void check_index(cs540::Map<int, int>& m, const std::set<int>& ref) {
+  assert(m.size() == ref.size());
+  std::vector<int> keys(ref.begin(), ref.end());
+  for (size_t i = 0; i < keys.size(); i++) {
+    assert(m.nth(i)->first == keys[i]);
+    assert(m.rank(keys[i]) == i);
+    assert(m.rank(keys[i] + 1) == i + 1 || (i + 1 < keys.size() && keys[i + 1] == keys[i] + 1));
+  }
+  assert(m.nth(keys.size()) == m.end());
+  for (size_t i = 0; i < keys.size(); i += 7) {
+    for (size_t k: {size_t(0), size_t(1), size_t(13), size_t(200)}) {
+      auto it = m.begin() + i;
+      it += k;
+      assert(i + k >= keys.size() ? it == m.end() : it->first == keys[i + k]);
+    }
+  }
+  const cs540::Map<int, int>& cm = m;
+  if (!keys.empty()) {
+    assert((cm.begin() + (keys.size() - 1))->first == keys.back());
+    assert(cm.nth(keys.size() / 2)->first == keys[keys.size() / 2]);
+  }
+}
+
+void test_indexable() {
+  cs540::Map<int, int> m;
+  std::set<int> ref;
+  check_index(m, ref);
+
+  std::mt19937 gen(11);
+  for (int i = 0; i < 3000; i++) {
+    int k = gen() % 5000;
+    if (gen() % 3 == 0 && ref.count(k)) {
+      m.erase(k);
+      ref.erase(k);
+    } else {
+      m.insert({k, k});
+      ref.insert(k);
+    }
+  }
+  check_index(m, ref);
+
+  // Bulk load on top, with some stragglers mixed in
+  std::vector<std::pair<int, int>> more;
+  for (int i = 0; i < 2000; i++) {
+    more.push_back({5000 + i * 3, 0});
+    if (i % 100 == 0) more.push_back({int(gen() % 5000), 0});
+  }
+  m.insert(more.begin(), more.end());
+  for (auto& kv: more) ref.insert(kv.first);
+  check_index(m, ref);
+
+  cs540::Map<int, int> copy(m);
+  check_index(copy, ref);
+  copy.clear();
+  check_index(copy, std::set<int>());
+  copy = m;
+  check_index(copy, ref);
+  copy.insert(copy.end(), {1 << 20, 0});
+  ref.insert(1 << 20);
+  check_index(copy, ref);
+}
+
+// Hints nowhere near the finger still go in right there, with the widths
+// that come along with it
+void test_far_hints() {
+  cs540::Map<int, int> m;
+  std::set<int> ref;
+  for (int i = 0; i < 4000; i++) {
+    m.insert({i * 4, i});
+    ref.insert(i * 4);
+  }
+  std::mt19937 gen(13);
+  for (int i = 0; i < 2000; i++) {
+    // Drag the finger to one end, then hint somewhere random
+    m.insert({(i % 2) ? -1 - i : 20000 + i, 0});
+    ref.insert((i % 2) ? -1 - i : 20000 + i);
+    int k = int(gen() % 4000) * 4 + 1 + int(gen() % 3);
+    if (ref.count(k)) {
+      continue;
+    }
+    auto after = m.upper_bound(k);
+    auto put = m.insert(after, {k, i});
+    assert(put->first == k && ++put == after);
+    ref.insert(k);
+  }
+  check_index(m, ref);
+}
+
+void test_ranges() {
+  cs540::Map<int, int> m;
+  for (int i = 0; i < 1000; i++) {
+    m.insert({i * 2, i});
+  }
+  const cs540::Map<int, int>& cm = m;
+
+  assert(m.lower_bound(10)->first == 10 && m.upper_bound(10)->first == 12);
+  assert(m.lower_bound(11)->first == 12 && cm.upper_bound(11)->first == 12);
+  assert(m.lower_bound(-5) == m.begin() && cm.lower_bound(5000) == cm.end());
+  assert(m.upper_bound(1998) == m.end());
+  auto r = m.equal_range(20);
+  assert(r.first->first == 20 && r.second->first == 22);
+  auto cr = cm.equal_range(21);
+  assert(cr.first == cr.second && cr.first->first == 22);
+
+  // Range erase against std::set, including off either end
+  std::set<int> ref;
+  for (auto& kv: m) ref.insert(kv.first);
+  std::mt19937 gen(3);
+  for (int round = 0; round < 200 && !ref.empty(); round++) {
+    int a = int(gen() % 2200) - 100, b = a + int(gen() % 60);
+    auto it = m.erase(m.lower_bound(a), m.lower_bound(b));
+    assert(it == m.lower_bound(b));
+    ref.erase(ref.lower_bound(a), ref.lower_bound(b));
+    if (round % 10 == 0) {
+      for (int i = 0; i < 30; i++) {
+        int k = gen() % 2000;
+        m.insert({k, 0});
+        ref.insert(k);
+      }
+    }
+  }
+  check_index(m, ref);
+  std::vector<int> back;
+  for (auto it = m.rbegin(); it != m.rend(); it++) back.push_back(it->first);
+  assert(std::equal(back.rbegin(), back.rend(), ref.begin()));
+
+  assert(m.erase(m.begin(), m.end()) == m.end());
+  assert(m.empty() && m.begin() == m.end());
+  m.insert({1, 1});
+  assert(m.size() == 1 && m.nth(0)->first == 1);
+}
+
+// Only orders through KeyCompare, there's no operator< at all
+struct Descending {
+  int v;
+};
+struct DescendingLess {
+  bool operator()(const Descending& a, const Descending& b) const { return a.v > b.v; }
+};
+namespace cs540 {
+  template <>
+  struct KeyCompare<Descending> {
+    using type = DescendingLess;
+  };
+}
+
+void test_find_batch() {
+  cs540::Map<int, int> m;
+  std::mt19937 gen(9);
+  for (int i = 0; i < 20000; i++) {
+    int k = gen() % 100000;
+    m.insert({k, k + 1});
+  }
+  const cs540::Map<int, int>& cm = m;
+
+  // Small unsorted batches take the interleaved path, big or sorted ones the
+  // sweep, both have to agree with find
+  for (size_t n: {size_t(0), size_t(1), size_t(7), size_t(500), size_t(5000)}) {
+    std::vector<int> keys;
+    for (size_t i = 0; i < n; i++) keys.push_back(int(gen() % 100010) - 5);
+    for (int pass = 0; pass < 2; pass++) {
+      std::vector<cs540::Map<int, int>::Iterator> out;
+      m.find_batch(keys, out);
+      assert(out.size() == keys.size());
+      for (size_t i = 0; i < n; i++) {
+        assert(out[i] == m.find(keys[i]));
+      }
+      std::vector<cs540::Map<int, int>::ConstIterator> cfound;
+      cm.find_batch(keys, cfound);
+      for (size_t i = 0; i < n; i++) {
+        assert(cfound[i] == cm.find(keys[i]));
+      }
+      std::sort(keys.begin(), keys.end());
+    }
+  }
+
+  cs540::Map<int, int> empty;
+  std::vector<cs540::Map<int, int>::Iterator> out;
+  empty.find_batch({1, 2, 3}, out);
+  assert(out.size() == 3 && out[0] == empty.end());
+
+  // Sorted means sorted by the map's comparator
+  cs540::Map<Descending, int> d;
+  for (int i = 0; i < 1000; i += 2) {
+    d.insert(std::make_pair(Descending{i}, i));
+  }
+  std::vector<Descending> dkeys;
+  for (int i = 50; i > 0; i--) {
+    dkeys.push_back(Descending{i});
+  }
+  std::vector<cs540::Map<Descending, int>::Iterator> dout;
+  d.find_batch(dkeys, dout);
+  for (size_t i = 0; i < dkeys.size(); i++) {
+    assert(dkeys[i].v % 2 ? dout[i] == d.end() : dout[i]->second == dkeys[i].v);
+  }
+}
 
-  std::cout << std::string(MAX_SKIP_LIST_HEIGHT, '-') << std::endl;
+void test_iterator_erase() {
+  // String keys take the back link walk, ints the finger, both have to
+  // leave positions and reverse links intact
+  cs540::Map<std::string, int> m;
+  std::set<std::string> ref;
+  std::mt19937 gen(21);
+  for (int i = 0; i < 5000; i++) {
+    std::string k = std::to_string(gen() % 20000);
+    m.insert({k, i});
+    ref.insert(k);
+  }
+  for (int i = 0; i < 3000 && !ref.empty(); i++) {
+    size_t idx = gen() % ref.size();
+    auto it = m.nth(idx);
+    ref.erase(it->first);
+    m.erase(it);
+    if (i % 500 == 0) {
+      m.erase(m.begin());
+      ref.erase(ref.begin());
+    }
+  }
+  assert(m.size() == ref.size());
+  size_t i = 0;
+  for (auto& k: ref) {
+    assert(m.nth(i)->first == k && m.rank(k) == i);
+    i++;
+  }
+  auto rit = ref.rbegin();
+  for (auto it = m.rbegin(); it != m.rend(); it++) {
+    assert(it->first == *rit++);
+  }
+
+  cs540::Map<int, int> n;
+  for (int j = 0; j < 1000; j++) n.insert({j, j});
+  for (auto it = n.begin(); it != n.end();) {
+    auto t = it++;
+    n.erase(t);
+    if (it != n.end()) it++;
+  }
+  assert(n.size() == 500 && n.nth(0)->first == 1 && n.rank(999) == 499);
+  n.erase(n.nth(250));
+  assert(n.find(501) == n.end() && n.nth(250)->first == 503);
+}
+
+// Counts how often it gets copied, moved or built
+struct Heavy {
+  static int copies, moves, builds;
+  std::vector<int> payload;
+  Heavy(): payload(100) { builds++; }
+  Heavy(int a, int b): payload(a, b) { builds++; }
+  Heavy(const Heavy& h): payload(h.payload) { copies++; }
+  Heavy(Heavy&& h): payload(std::move(h.payload)) { moves++; }
+  Heavy& operator=(const Heavy&) = default;
+  static void reset() { copies = moves = builds = 0; }
+};
+int Heavy::copies, Heavy::moves, Heavy::builds;
+
+void test_move_semantics() {
+  cs540::Map<std::string, Heavy> m;
+  Heavy::reset();
+  for (int i = 0; i < 100; i++) {
+    assert(m.try_emplace(std::to_string(i), 10, i).second);
+  }
+  assert(Heavy::builds == 100 && Heavy::copies == 0 && Heavy::moves == 0);
+
+  // Already there, so nothing gets built
+  assert(!m.try_emplace("5", 10, -1).second);
+  assert(m["7"].payload[0] == 7);
+  assert(Heavy::builds == 100 && Heavy::copies == 0);
+
+  m["new"].payload.push_back(1);
+  assert(Heavy::builds == 101 && m.at("new").payload.size() == 101);
+
+  auto res = m.emplace(std::piecewise_construct, std::forward_as_tuple("e"), std::forward_as_tuple(3, 3));
+  assert(res.second && res.first->second.payload.size() == 3);
+  assert(!m.emplace("e", Heavy(1, 1)).second && m.at("e").payload.size() == 3);
+
+  Heavy::reset();
+  assert(m.insert(std::make_pair(std::string("moved"), Heavy(2, 2))).second);
+  assert(Heavy::copies == 0);
+
+  // Moves hand over the nodes, the source is empty but still usable
+  size_t sz = m.size();
+  cs540::Map<std::string, Heavy> n(std::move(m));
+  assert(n.size() == sz && m.size() == 0 && m.begin() == m.end());
+  assert(n.at("42").payload[0] == 42 && n.nth(n.rank("42"))->first == "42");
+  m.try_emplace("back");
+  assert(m.size() == 1 && m.find("back") != m.end());
+
+  cs540::Map<std::string, Heavy> o;
+  o.try_emplace("gone");
+  o = std::move(n);
+  assert(o.size() == sz && n.empty() && o.find("gone") == o.end());
+  o = std::move(o);
+  assert(o.size() == sz);
+  assert(Heavy::copies == 0);
+
+  // Move iterators move in range insert
+  std::vector<std::pair<const std::string, Heavy>> src;
+  for (int i = 0; i < 10; i++) src.emplace_back("r" + std::to_string(i), Heavy(1, i));
+  Heavy::reset();
+  cs540::Map<std::string, Heavy> p;
+  p.insert(std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+  assert(p.size() == 10 && Heavy::copies == 0);
+  for (size_t i = 0; i < o.size(); i++) {
+    assert(o.rank(o.nth(i)->first) == i);
+  }
+}
+
+// Knows how to compare against a plain int, and counts how often one gets built
+struct Ticket {
+  static int built;
+  int id;
+  Ticket(int i): id(i) { built++; }
+  Ticket(const Ticket& t): id(t.id) { built++; }
+  bool operator<(const Ticket& t) const { return id < t.id; }
+  bool operator==(const Ticket& t) const { return id == t.id; }
+};
+int Ticket::built;
+bool operator<(const Ticket& t, int i) { return t.id < i; }
+bool operator<(int i, const Ticket& t) { return i < t.id; }
+
+namespace cs540 {
+  template <>
+  struct KeyCompare<Ticket> {
+    using type = TransparentLess;
+  };
+}
+
+void test_heterogeneous_lookup() {
+  cs540::Map<std::string, std::string> m;
+  for (int i = 0; i < 100; i += 2) {
+    m.insert(std::make_pair(std::to_string(i), std::to_string(i * i)));
+  }
+  const char *key = "42";
+  assert(m.find(key)->second == "1764" && m.at(key) == "1764");
+  assert(m.count("42") == 1 && m.count("43") == 0 && m.count(std::string("44")) == 1);
+  assert(m.lower_bound("43")->first == "44" && m.upper_bound("44")->first == "46");
+  assert(m.find("43") == m.end());
+  bool threw = false;
+  try {
+    m.at("43");
+  } catch (const std::out_of_range&) {
+    threw = true;
+  }
+  assert(threw);
+  m.erase("42");
+  assert(m.count("42") == 0 && m.size() == 49);
+#if __cplusplus >= 201703L
+  std::string buf = "xx10xx";
+  std::string_view sv(buf.data() + 2, 2);
+  assert(m.find(sv)->first == "10" && m.at(sv) == "100" && m.count(sv) == 1);
+  assert(m.lower_bound(sv)->first == "10");
+  m.erase(sv);
+  assert(m.find(sv) == m.end());
+#endif
+
+  cs540::Map<Ticket, int> t;
   for (int i = 0; i < 50; i++) {
-    std::cout << std::string(rand_height(), '*') << std::endl;
+    t.insert(std::make_pair(Ticket(i), i));
+  }
+  Ticket::built = 0;
+  const cs540::Map<Ticket, int>& ct = t;
+  assert(ct.find(7)->second == 7 && ct.at(8) == 8 && ct.count(9) == 1 && ct.count(50) == 0);
+  assert(t.lower_bound(10)->first.id == 10 && t.upper_bound(10)->first.id == 11);
+  t.erase(7);
+  assert(t.count(7) == 0 && t.size() == 49);
+  assert(Ticket::built == 0);
+}
+
+template <typename Cmp, typename C, typename A, typename B>
+int sign(const C& cmp, const A& a, const B& b) {
+  int c = Cmp::compare(cmp, a, b);
+  return (c > 0) - (c < 0);
+}
+
+void test_three_way() {
+  typedef cs540::ThreeWayCompare<std::less<int>, int> IntCmp;
+  typedef cs540::ThreeWayCompare<std::less<unsigned long>, unsigned long> ULongCmp;
+  typedef cs540::ThreeWayCompare<std::less<std::string>, std::string> StrCmp;
+  typedef cs540::ThreeWayCompare<cs540::TransparentLess, std::string> StrViewCmp;
+  typedef cs540::ThreeWayCompare<std::less<double>, double> DoubleCmp;
+  assert(sign<IntCmp>(std::less<int>(), 1, 2) == -1 && sign<IntCmp>(std::less<int>(), 2, 2) == 0 && sign<IntCmp>(std::less<int>(), -5, -6) == 1);
+  assert(sign<ULongCmp>(std::less<unsigned long>(), ~0ul, 0ul) == 1);
+  assert(sign<StrCmp>(std::less<std::string>(), std::string("ab"), std::string("abc")) == -1);
+  assert(sign<StrViewCmp>(cs540::TransparentLess(), std::string("b"), "a") == 1 && sign<StrViewCmp>(cs540::TransparentLess(), std::string("b"), "b") == 0);
+  assert(sign<DoubleCmp>(std::less<double>(), 1.5, 0.5) == 1 && sign<DoubleCmp>(std::less<double>(), 0.5, 0.5) == 0);
+
+  // Three way descents have to agree with std::set, hits on every level
+  // included
+  cs540::Map<std::string, int> m;
+  std::set<std::string> ref;
+  std::mt19937 gen(11);
+  for (int i = 0; i < 3000; i++) {
+    std::string k = "k" + std::to_string(gen() % 5000);
+    m.insert(std::make_pair(k, i));
+    ref.insert(k);
+  }
+  for (int i = 0; i < 5000; i++) {
+    std::string k = "k" + std::to_string(i);
+    auto it = m.find(k);
+    assert((it != m.end()) == (ref.count(k) == 1));
+    assert(it == m.end() || it->first == k);
+    assert(m.count(k.c_str()) == ref.count(k));
+  }
+  assert(m.find("") == m.end() && m.find("z") == m.end());
+}
+
+void test_copies() {
+  cs540::Map<int, std::string> live;
+  std::vector<std::pair<int, std::string>> init;
+  for (int i = 0; i < 1000; i++) {
+    init.push_back(std::make_pair(i, std::to_string(i)));
+  }
+  live.insert(init.begin(), init.end());
+
+  // Copies are their own maps right away
+  cs540::Map<int, std::string> snap(live);
+  live[5] = "five";
+  live.erase(6);
+  live.insert(std::make_pair(2000, std::string("new")));
+  assert(snap.at(5) == "5" && snap.count(6) == 1 && snap.count(2000) == 0 && snap.size() == 1000);
+  assert(live.at(5) == "five" && live.count(6) == 0 && live.size() == 1000);
+  for (size_t i = 0; i < live.size(); i += 37) {
+    assert(live.rank(live.nth(i)->first) == i);
+  }
+
+  // Copying in the middle of a loop leaves the loop alone
+  std::vector<cs540::Map<int, std::string>> history;
+  size_t steps = 0;
+  for (auto it = live.begin(); it != live.end(); ++it) {
+    if (steps++ % 100 == 0) {
+      history.push_back(live);
+    }
+  }
+  assert(steps == live.size() && history.size() == 10);
+
+  // Iterators from before a copy still belong to the original
+  auto it = live.find(500);
+  cs540::Map<int, std::string> snap2 = live;
+  it->second = "changed";
+  assert(live.at(500) == "changed" && snap2.at(500) == "500");
+  live.erase(it);
+  assert(live.count(500) == 0 && snap2.count(500) == 1);
+  auto first = live.find(600);
+  auto last = live.find(700);
+  cs540::Map<int, std::string> snap3 = live;
+  auto after = live.erase(first, last);
+  assert(after == last && after->first == 700 && live.size() == 899 && snap3.size() == 999);
+  auto hint = live.find(700);
+  cs540::Map<int, std::string> snap4 = live;
+  auto put = live.insert(hint, std::make_pair(650, std::string("back")));
+  assert(put->first == 650 && ++put == hint && snap4.count(650) == 0);
+
+  // Copies outlive or die before the map they came from in any order
+  history.clear();
+  for (int round = 0; round < 5; round++) {
+    history.push_back(live);
+    live[round] = "round";
+  }
+  live.clear();
+  assert(live.empty() && history[0].at(0) == "0" && history[4].at(3) == "round");
+  history.erase(history.begin() + 1);
+  cs540::Map<int, std::string> moved(std::move(history[2]));
+  assert(history[2].empty() && moved.at(2) == "round" && moved.at(4) == "4");
+  history.clear();
+  assert(moved.size() == 900 && snap.size() == 1000);
+  snap = moved;
+  snap.erase(snap.begin(), snap.end());
+  assert(snap.empty() && moved.size() == 900);
+}
+
+template <typename M>
+void check_against(const M& m, const std::map<int, int>& ref) {
+  assert(m.size() == ref.size());
+  auto it = m.begin();
+  for (auto& kv: ref) {
+    assert(it->first == kv.first && it->second == kv.second);
+    ++it;
+  }
+  assert(it == m.end());
+  for (size_t i = 0; i < m.size(); i += 13) {
+    assert(m.rank(m.nth(i)->first) == i);
+  }
+}
+
+void test_set_ops() {
+  std::mt19937 gen(5);
+  for (int round = 0; round < 20; round++) {
+    cs540::Map<int, int> a, b;
+    std::map<int, int> ra, rb;
+    int na = gen() % 300, nb = gen() % 300, range = 1 + gen() % 600;
+    for (int i = 0; i < na; i++) {
+      int k = gen() % range;
+      a.insert(std::make_pair(k, k));
+      ra.insert(std::make_pair(k, k));
+    }
+    for (int i = 0; i < nb; i++) {
+      int k = gen() % range;
+      b.insert(std::make_pair(k, -k));
+      rb.insert(std::make_pair(k, -k));
+    }
+
+    std::map<int, int> u(ra), in, d;
+    u.insert(rb.begin(), rb.end());
+    for (auto& kv: ra) {
+      (rb.count(kv.first) ? in : d).insert(kv);
+    }
+    check_against(a.unite(b), u);
+    check_against(a.intersect(b), in);
+    check_against(a.subtract(b), d);
+
+    // Merged nodes don't move, the leftovers stay behind in b
+    const cs540::Map<int, int>& ca = a;
+    const cs540::Map<int, int>& cb = b;
+    std::map<int, const std::pair<const int, int> *> where;
+    for (auto& kv: cb) {
+      where[kv.first] = &kv;
+    }
+    cs540::Map<int, int> snap(a);
+    a.merge(b);
+    check_against(a, u);
+    std::map<int, int> left;
+    for (auto& kv: rb) {
+      if (ra.count(kv.first)) {
+        left.insert(kv);
+      } else {
+        assert(&*ca.find(kv.first) == where[kv.first]);
+      }
+    }
+    check_against(b, left);
+    check_against(snap, ra);
+
+    // Both stay fully usable, b dies first even though a has its old slabs
+    b.insert(std::make_pair(range + 1, 0));
+    a.erase(a.begin(), a.nth(a.size() / 2));
+    a.insert(std::make_pair(-1, -1));
+  }
+  cs540::Map<int, int> e;
+  e.merge(e);
+  assert(e.unite(e).empty());
+}
+
+void test_shrink_and_rebalance() {
+  // p = 0.9 builds towers way taller than this many elements need, then
+  // most of them get erased out from under the top levels
+  cs540::Map<int, int> m{cs540::SkipLevelGenerator(0.9, 0, 5)};
+  std::set<int> ref;
+  for (int i = 0; i < 3000; i++) {
+    m.insert({i, i});
+    ref.insert(i);
+  }
+  m.erase(m.nth(100), m.nth(2900));
+  ref.erase(ref.find(100), ref.find(2900));
+  std::mt19937 gen(8);
+  for (int i = 0; i < 150; i++) {
+    int k = *std::next(ref.begin(), gen() % ref.size());
+    m.erase(k);
+    ref.erase(k);
+  }
+  check_index(m, ref);
+  // Levels that went away come back when something tall enough shows up
+  for (int i = 0; i < 500; i++) {
+    m.insert({10000 + i, i});
+    ref.insert(10000 + i);
+  }
+  check_index(m, ref);
+  for (int i = 0; i < 500; i += 2) {
+    m.erase(10000 + i);
+    ref.erase(10000 + i);
+  }
+
+  // Same contents after a rebalance, and it keeps working like normal
+  cs540::Map<int, int> snap = m;
+  m.rebalance();
+  check_index(m, ref);
+  for (int k: ref) {
+    assert(m.at(k) == snap.at(k));
+  }
+  for (int i = 0; i < 300; i++) {
+    int k = gen() % 20000;
+    if (ref.count(k)) {
+      m.erase(k);
+      ref.erase(k);
+    } else {
+      m.insert({k, k});
+      ref.insert(k);
+    }
+  }
+  check_index(m, ref);
+  m.erase(m.begin(), m.end());
+  ref.clear();
+  check_index(m, ref);
+  m.rebalance();
+  check_index(m, ref);
+
+  // Values that own memory come through the move intact
+  cs540::Map<int, std::string> words;
+  for (int i = 0; i < 200; i++) {
+    words.insert({i, std::string(i, 'w')});
+  }
+  for (int i = 0; i < 200; i += 3) {
+    words.erase(i);
+  }
+  const cs540::Map<int, std::string> before = words;
+  words.rebalance();
+  assert(words == before && words.size() == before.size());
+  for (auto& kv: before) {
+    assert(words.at(kv.first) == kv.second && before.at(kv.first).size() == size_t(kv.first));
   }
-  std::cout << std::string(MAX_SKIP_LIST_HEIGHT, '-') << std::endl;
 }
 
 int main() {
   test_rand_height();
+  test_level_generator();
+  test_bulk_load();
+  test_finger_and_hint();
+  test_indexable();
+  test_far_hints();
+  test_ranges();
+  test_find_batch();
+  test_iterator_erase();
+  test_move_semantics();
+  test_heterogeneous_lookup();
+  test_three_way();
+  test_copies();
+  test_set_ops();
+  test_shrink_and_rebalance();
   return 0;
 }
@@ -1,7 +1,18 @@
+// Compile with -std=c++11 -O2
+//
+// Runs every scenario through the harness in Benchmark.hpp, --help lists
+// the options. Saving two runs with --format json --out FILE and handing
+// them to --compare BASE CURRENT flags whatever got slower. --workload SPEC
+// adds a string keyed workload of your own, see parse_spec in Workload.hpp.
+
 #include "Map.hpp"
-#include <chrono>
+#include "BPlusMap.hpp"
+#include "Benchmark.hpp"
+#include "Workload.hpp"
+#include <cstdio>
 #include <random>
 #include <iostream>
+#include <memory>
 #include <typeinfo>
 #include <cxxabi.h>
 #include <assert.h>
@@ -133,6 +144,11 @@ namespace cs540 {
       return m_map.insert(std::move(value)).first;
     }
     
+    template <typename IT_T>
+    void insert(IT_T range_beg, IT_T range_end) {
+      m_map.insert(range_beg, range_end);
+    }
+    
     void erase(const K &k) {
       m_map.erase(k);
     }
@@ -163,6 +179,19 @@ namespace cs540 {
       return m_map[k];
     }
     
+    Iterator lower_bound(const K &k) {
+      return m_map.lower_bound(k);
+    }
+    
+    ///////// Positional, linear since std::map doesn't keep counts
+    Iterator nth(size_t k) {
+      return k >= m_map.size() ? m_map.end() : std::next(m_map.begin(), k);
+    }
+    
+    size_t rank(const K &k) const {
+      return std::distance(m_map.begin(), m_map.lower_bound(k));
+    }
+    
     
   private:
     base_map m_map;
@@ -215,258 +244,255 @@ namespace cs540 {
   
 }
 
-using Milli = std::chrono::duration<double, std::ratio<1,1000>>;
-using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
-
-void dispTestName(const char *testName, const char *typeName) {
-  std::cout << std::endl << std::endl << "************************************" << std::endl;
-  std::cout << "\t" << testName << " for " << typeName << "\t" << std::endl;
-  std::cout << "************************************" << std::endl << std::endl;
-}
+using cs540::bench::Harness;
+using cs540::bench::do_not_optimize;
 
 template <typename T>
-T ascendingInsert(int count, bool print = true) {
-  using namespace std::chrono;
-  TimePoint start, end;
-  start = system_clock::now();
-  T map; 
+T ascendingInsert(int count) {
+  T map;
   for(int i = 0; i < count; i++) {
     map.insert(std::pair<int, int>(i,i));
   }
-  end = system_clock::now();
-  
-  Milli elapsed = end - start;
-  
-  if(print)
-    std::cout << "Inserting " << count << " elements in aescending order took " << elapsed.count() << " milliseconds" << std::endl;
-  
   return map;
 }
 
 template <typename T>
-T descendingInsert(int count, bool print = true) {
-  using namespace std::chrono;
-  TimePoint start, end;
-  start = system_clock::now();
-  T map; 
-  for(int i = count; i > 0; i--) {
-    map.insert(std::pair<int, int>(i,i));
-  }
-  end = system_clock::now();
-  
-  Milli elapsed = end - start;
-  
-  if(print)
-    std::cout << "Inserting " << count << " elements in descending order took " << elapsed.count() << " milliseconds" << std::endl;
-  return map;
-}
+void insertTests(Harness &h, const std::string &subject, int count) {
+  auto empty = []() { return T(); };
+  h.run("ascending insert", subject, count, empty, [&](T &map) {
+    for(int i = 0; i < count; i++) {
+      map.insert(std::pair<int, int>(i,i));
+    }
+  });
 
-template <typename T>
-void deleteTest() {
-  using namespace std::chrono;
-  TimePoint start, end;
-  T m1 = ascendingInsert<T>(10000, false);
-  T m2 = ascendingInsert<T>(100000, false);
-  T m3 = ascendingInsert<T>(1000000, false);
-  T m4 = ascendingInsert<T>(10000000, false);
-  
-  std::set<int> toDelete;
-  for(int i = 0; i < 10000; i++) {
-    toDelete.insert(i);
-  }
-  
-  start = system_clock::now();
-  for(const int e : toDelete)
-    m1.erase(e);
-  end = system_clock::now();
-  
-  Milli elapsed1 = end - start;
-  
-  std::cout << "deleting 10000 elements from a map of size 10000 took " << elapsed1.count() << " milliseconds" << std::endl;
-  
-  {
-    toDelete.clear();
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(0,99999);
-    while(toDelete.size() < 10000) {
-      toDelete.insert(distribution(generator));
+  if(h.wanted("bulk load", count)) {
+    std::vector<std::pair<int, int>> sorted;
+    sorted.reserve(count);
+    for(int i = 0; i < count; i++) {
+      sorted.push_back(std::pair<int, int>(i,i));
     }
+    h.run("bulk load", subject, count, empty, [&](T &map) {
+      map.insert(sorted.begin(), sorted.end());
+    });
   }
-  
-  start = system_clock::now();
-  for(const int e : toDelete)
-    m2.erase(e);
-  end = system_clock::now();
-  
-  Milli elapsed2 = end - start;
-  
-  std::cout << "deleting 10000 elements from a map of size 100000 took " << elapsed2.count() << " milliseconds" << std::endl;
-  
-  {
-    toDelete.clear();
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(0,999999);
-    while(toDelete.size() < 10000) {
-      toDelete.insert(distribution(generator));
+
+  h.run("descending insert", subject, count, empty, [&](T &map) {
+    for(int i = count; i > 0; i--) {
+      map.insert(std::pair<int, int>(i,i));
     }
-  }
-  
-  start = system_clock::now();
-  for(const int e : toDelete)
-    m3.erase(e);
-  end = system_clock::now();
-  
-  Milli elapsed3 = end - start;
-  
-  std::cout << "deleting 10000 elements from a map of size 1000000 took " << elapsed3.count() << " milliseconds" << std::endl;
-  
-  {
-    toDelete.clear();
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(0,9999999);
-    while(toDelete.size() < 10000) {
-      toDelete.insert(distribution(generator));
+  });
+}
+
+// Up to 10000 random keys out of [0, count), repeats allowed or not
+std::vector<int> randomKeys(int count, bool distinct) {
+  std::vector<int> keys;
+  std::set<int> seen;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0,count-1);
+  while(keys.size() < 10000 && keys.size() < size_t(count)) {
+    int k = distribution(generator);
+    if(!distinct || seen.insert(k).second) {
+      keys.push_back(k);
     }
   }
-  
-  start = system_clock::now();
-  for(const int e : toDelete)
-    m4.erase(e);
-  end = system_clock::now();
-  
-  Milli elapsed4 = end - start;
-  
-  std::cout << "deleting 10000 elements from a map of size 10000000 took " << elapsed4.count() << " milliseconds" << std::endl;
+  return keys;
 }
 
 template <typename T>
-void findTest() {
-  using namespace std::chrono;
-  TimePoint start, end;
-  T m1 = ascendingInsert<T>(10000, false);
-  T m2 = ascendingInsert<T>(100000, false);
-  T m3 = ascendingInsert<T>(1000000, false);
-  T m4 = ascendingInsert<T>(10000000, false);
-  T m11;
-  T m22;
-  T m33;
-  T m44;
-  
-  std::vector<int> toFind;
-  for(int i = 0; i < 10000; i++) {
-    toFind.push_back(i);
+void deleteTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("delete", count)) {
+    return;
   }
-  
-  start = system_clock::now();
-  for(const int e : toFind) {
-    auto it = m1.find(e);
-    m11.insert(*it);
+  std::vector<int> toDelete = randomKeys(count, true);
+  std::sort(toDelete.begin(), toDelete.end());
+  h.run("delete", subject, count, [&]() { return ascendingInsert<T>(count); }, [&](T &map) {
+    for(const int e : toDelete)
+      map.erase(e);
+  });
+}
+
+template <typename T>
+void findTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("find", count)) {
+    return;
   }
-  end = system_clock::now();
-  
-  Milli elapsed1 = end - start;
-  
-  std::cout << "Finding 10000 elements from a map of size " << m1.size() << " took " << elapsed1.count() << " milliseconds" << std::endl;
-  
-  {
-    toFind.clear();
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(0,99999);
-    while(toFind.size() < 10000) {
-      toFind.push_back(distribution(generator));
+  T m = ascendingInsert<T>(count);
+  std::vector<int> toFind = randomKeys(count, false);
+  h.run_plain("find", subject, count, [&]() {
+    long sum = 0;
+    for(const int e : toFind) {
+      sum += m.find(e)->second;
     }
+    do_not_optimize(sum);
+  });
+}
+
+// Same lookups as findTest, one find per key against a single find_batch
+template <typename T>
+void batchFindTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("batch find", count)) {
+    return;
   }
-  
-  start = system_clock::now();
-  for(const int e : toFind) {
-    auto it = m2.find(e);
-    m22.insert(*it);
-  }
-  end = system_clock::now();
-  
-  Milli elapsed2 = end - start;
-  
-  std::cout << "Finding 10000 elements from a map of size " << m2.size() << " took " << elapsed2.count() << " milliseconds" << std::endl;
-  
-  {
-    toFind.clear();
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(0,999999);
-    while(toFind.size() < 10000) {
-      toFind.push_back(distribution(generator));
+  T m = ascendingInsert<T>(count);
+  std::vector<int> toFind = randomKeys(count, false);
+  
+  long sum1 = 0, sum2 = 0;
+  h.run_plain("batch find one by one", subject, count, [&]() {
+    sum1 = 0;
+    for(const int e : toFind) {
+      sum1 += m.find(e)->second;
     }
+    do_not_optimize(sum1);
+  });
+  
+  std::vector<typename T::Iterator> found;
+  h.run_plain("batch find find_batch", subject, count, [&]() {
+    sum2 = 0;
+    m.find_batch(toFind, found);
+    for(auto &it : found) {
+      sum2 += it->second;
+    }
+    do_not_optimize(sum2);
+  });
+  assert(sum1 == sum2);
+}
+
+// Keys that share a long prefix, so every compare has to get past it
+template <typename T>
+void stringFindTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("string find", count)) {
+    return;
   }
-  
-  start = system_clock::now();
-  for(const int e : toFind) {
-    auto it = m3.find(e);
-    m33.insert(*it);
+  auto key = [](int i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "user:session:%08d", i);
+    return std::string(buf);
+  };
+  T m;
+  for(int i = 0; i < count; i++) {
+    m.insert(std::pair<std::string, int>(key(2 * i), i));
   }
-  end = system_clock::now();
-  
-  Milli elapsed3 = end - start;
   
-  std::cout << "Finding 10000 elements from a map of size " << m3.size() << " took " << elapsed3.count() << " milliseconds" << std::endl;
+  // Half of them miss
+  std::vector<std::string> toFind;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0,2*count-1);
+  while(toFind.size() < 100000) {
+    toFind.push_back(key(distribution(generator)));
+  }
   
-  {
-    toFind.clear();
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(0,9999999);
-    while(toFind.size() < 10000) {
-      toFind.push_back(distribution(generator));
+  h.run_plain("string find", subject, count, [&]() {
+    long hits = 0;
+    for(const std::string &e : toFind) {
+      hits += m.find(e) != m.end();
     }
+    do_not_optimize(hits);
+  });
+}
+
+// Two shards with overlapping keys, combined the old way with a copy and an
+// insert per element, then with unite and with merge
+template <typename T>
+void setOpsTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("union", count)) {
+    return;
   }
-  
-  start = system_clock::now();
-  for(const int e : toFind) {
-    auto it = m4.find(e);
-    m44.insert(*it);
+  std::vector<std::pair<int, int>> ka, kb;
+  for(int i = 0; i < count; i++) {
+    ka.push_back(std::pair<int, int>(2 * i, i));
+    kb.push_back(std::pair<int, int>(3 * i, i));
   }
-  end = system_clock::now();
-  
-  Milli elapsed4 = end - start;
-  
-  std::cout << "Finding 10000 elements from a map of size " << m4.size() << " took " << elapsed4.count() << " milliseconds" << std::endl;
+  auto shards = [&]() {
+    std::pair<T, T> ab;
+    ab.first.insert(ka.begin(), ka.end());
+    ab.second.insert(kb.begin(), kb.end());
+    return ab;
+  };
   
+  h.run("union one by one", subject, count, shards, [&](std::pair<T, T> &ab) {
+    T looped(ab.first);
+    for(auto &kv : ab.second) {
+      looped.insert(kv);
+    }
+    do_not_optimize(looped.size());
+  });
+  h.run("union unite", subject, count, shards, [&](std::pair<T, T> &ab) {
+    do_not_optimize(ab.first.unite(ab.second).size());
+  });
+  h.run("union merge", subject, count, shards, [&](std::pair<T, T> &ab) {
+    ab.first.merge(ab.second);
+  });
 }
 
 template <typename T>
-void iterationTest(int count) {
-  using namespace std::chrono;
-  T m = ascendingInsert<T>(count,false);
-  
-  TimePoint start, end;
+void iterationTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("iteration", count)) {
+    return;
+  }
+  T m = ascendingInsert<T>(count);
   
-  for(int j = 0; j < 3; j++) {
-    start = system_clock::now();
+  // Warmup passes bring in whatever fits in cache first
+  h.run_plain("iteration", subject, count, [&]() {
     for(auto it = m.begin(); it != m.end(); it++) {
-      if(j==2)
-        (*it).second += j;
+      (*it).second += 1;
     }
-    end = system_clock::now();
+  });
+}
+
+template <typename T>
+void copyTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("copy", count)) {
+    return;
   }
+  T m = ascendingInsert<T>(count);
   
-  Milli elapsed = end - start;
-  
-  std::cout << "Iterating across " << count << " elements in a map of size " << count << " took " << elapsed.count() << " milliseconds time per iteration was " << elapsed.count()/double(count)*1e6 << " nanoseconds" << std::endl;
+  // Copies get thrown away after the clock stops
+  h.run("copy", subject, count, []() { return std::unique_ptr<T>(); }, [&](std::unique_ptr<T> &copy) {
+    copy.reset(new T(m));
+  });
 }
 
+// Percentile queries: nth at evenly spread ranks, then rank of the keys found
 template <typename T>
-void copyTest(int count) {
-  using namespace std::chrono;
-  T m = ascendingInsert<T>(count,false);
-  
-  TimePoint start, end;
+void indexTest(Harness &h, const std::string &subject, int count) {
+  if(!h.wanted("nth", count) && !h.wanted("rank", count)) {
+    return;
+  }
+  T m = ascendingInsert<T>(count);
+  const int queries = 1000;
   
-  start = system_clock::now();
-  T m2(m);
-  end = system_clock::now();
-
-  Milli elapsed = end - start;
+  h.run_plain("nth", subject, count, [&]() {
+    long sum = 0;
+    for(int q = 0; q < queries; q++) {
+      sum += m.nth(size_t(count) * q / queries)->first;
+    }
+    do_not_optimize(sum);
+  });
   
-  std::cout << "Copy construction of a map of size " << m2.size() << " took " << elapsed.count() << " milliseconds" << std::endl;
+  h.run_plain("rank", subject, count, [&]() {
+    long sum = 0;
+    for(int q = 0; q < queries; q++) {
+      sum += m.rank(int(size_t(count) * q / queries));
+    }
+    do_not_optimize(sum);
+  });
 }
 
+// Replays a pregenerated workload on a freshly loaded map every rep
+template <typename T>
+cs540::workload::Stats workloadTest(Harness &h, const std::string &subject, const std::string &name,
+                                    const cs540::workload::Workload &wl) {
+  cs540::workload::Stats stats;
+  h.run(name, subject, wl.spec().records, [&]() {
+    std::unique_ptr<T> map(new T);
+    cs540::workload::load(*map, wl);
+    return map;
+  }, [&](std::unique_ptr<T> &map) {
+    stats = cs540::workload::run(*map, wl);
+    do_not_optimize(stats.bytes);
+  });
+  return stats;
+}
 
 /*
   #include <assert.h>
@@ -495,69 +521,97 @@ void copyTest(int count) {
   }
 */
 
-class comma_numpunct : public std::numpunct<char> {
-protected:
-  virtual char do_thousands_sep() const { return ','; }
-  virtual std::string do_grouping() const { return "\03"; }
-};
-
-
-int main() {
-  //separate all printed numbers with commas
-  std::locale comma_locale(std::locale(), new comma_numpunct());
-  std::cout.imbue(comma_locale);
+int main(int argc, char *argv[]) {
+  auto usage = [&](std::ostream &os) {
+    os << "usage: " << argv[0] << " [--warmup N] [--reps N] [--cpu N] [--max-n N] [--filter CASE]\n"
+       << "       [--format text|json|csv] [--out FILE] [--workload SPEC]...\n"
+       << "   or: " << argv[0] << " --compare BASE CURRENT [--threshold FRACTION]\n";
+  };
+  if(argc == 2 && std::string(argv[1]) == "--help") {
+    usage(std::cout);
+    return 0;
+  }
+  // Workloads are ours, everything else goes to the harness
+  std::vector<std::pair<std::string, cs540::workload::Spec>> custom;
+  std::vector<char *> rest(argv, argv + 1);
+  cs540::bench::Options opts;
+  try {
+    for(int i = 1; i < argc; i++) {
+      if(std::string(argv[i]) != "--workload") {
+        rest.push_back(argv[i]);
+      } else if(i + 1 < argc) {
+        custom.push_back(std::make_pair(std::string("workload ") + argv[i + 1],
+                                        cs540::workload::parse_spec(argv[i + 1])));
+        i++;
+      } else {
+        throw std::invalid_argument("missing value for --workload");
+      }
+    }
+    opts = cs540::bench::parse_args(int(rest.size()), rest.data());
+  } catch (const std::invalid_argument &e) {
+    std::cerr << e.what() << "\n";
+    usage(std::cerr);
+    return 2;
+  }
+  if(!opts.compare_base.empty()) {
+    return cs540::bench::compare(opts.compare_base, opts.compare_current, opts.threshold, std::cout) > 0;
+  }
   
   auto demangle = [](const std::type_info &ti) {
     int ec;
-    return abi::__cxa_demangle(ti.name(), 0, 0, &ec);
+    char *name = abi::__cxa_demangle(ti.name(), 0, 0, &ec);
     assert(ec == 0);
+    std::string s(name);
+    free(name);
+    // Nobody wants to read the whole thing
+    const std::string str = "std::__cxx11::basic_string<char, std::char_traits<char>, std::allocator<char> >";
+    for(size_t p; (p = s.find(str)) != std::string::npos;) {
+      s.replace(p, str.size(), "std::string");
+    }
+    return s;
   };
   
-  const char *w = demangle(typeid(cs540::StdMapWrapper<int,int>));
-  const char *m = demangle(typeid(cs540::Map<int,int>));
+  const std::string w = demangle(typeid(cs540::StdMapWrapper<int,int>));
+  const std::string m = demangle(typeid(cs540::Map<int,int>));
+  const std::string b = demangle(typeid(cs540::BPlusMap<int,int>));
   
-  {
-    dispTestName("Ascending insert", m);
-    ascendingInsert<cs540::Map<int,int>>(1000);
-    ascendingInsert<cs540::Map<int,int>>(10000);
-    ascendingInsert<cs540::Map<int,int>>(100000);
-    ascendingInsert<cs540::Map<int,int>>(1000000);
-    ascendingInsert<cs540::Map<int,int>>(10000000);
-    dispTestName("Ascending insert", w);
-    ascendingInsert<cs540::StdMapWrapper<int,int>>(1000);
-    ascendingInsert<cs540::StdMapWrapper<int,int>>(10000);
-    ascendingInsert<cs540::StdMapWrapper<int,int>>(100000);
-    ascendingInsert<cs540::StdMapWrapper<int,int>>(1000000);
-    ascendingInsert<cs540::StdMapWrapper<int,int>>(10000000);
+  Harness h(opts);
+  const int sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+  
+  for(int n : sizes) {
+    insertTests<cs540::Map<int,int>>(h, m, n);
+    insertTests<cs540::StdMapWrapper<int,int>>(h, w, n);
+    insertTests<cs540::BPlusMap<int,int>>(h, b, n);
   }
   
-  {
-    dispTestName("Descending insert", m);
-    descendingInsert<cs540::Map<int,int>>(1000);
-    descendingInsert<cs540::Map<int,int>>(10000);
-    descendingInsert<cs540::Map<int,int>>(100000);
-    descendingInsert<cs540::Map<int,int>>(1000000);
-    descendingInsert<cs540::Map<int,int>>(10000000);
-    dispTestName("Descending insert", w);
-    descendingInsert<cs540::StdMapWrapper<int,int>>(1000);
-    descendingInsert<cs540::StdMapWrapper<int,int>>(10000);
-    descendingInsert<cs540::StdMapWrapper<int,int>>(100000);
-    descendingInsert<cs540::StdMapWrapper<int,int>>(1000000);
-    descendingInsert<cs540::StdMapWrapper<int,int>>(10000000);
+  for(int n : sizes) {
+    if(n < 10000) continue;
+    deleteTest<cs540::Map<int,int>>(h, m, n);
+    deleteTest<cs540::StdMapWrapper<int,int>>(h, w, n);
+    deleteTest<cs540::BPlusMap<int,int>>(h, b, n);
   }
   
-  {
-    dispTestName("Delete test", m);
-    deleteTest<cs540::Map<int,int>>();
-    dispTestName("Delete test", w);
-    deleteTest<cs540::StdMapWrapper<int,int>>();
+  for(int n : sizes) {
+    if(n < 10000) continue;
+    findTest<cs540::Map<int,int>>(h, m, n);
+    findTest<cs540::StdMapWrapper<int,int>>(h, w, n);
+    findTest<cs540::BPlusMap<int,int>>(h, b, n);
+    batchFindTest<cs540::Map<int,int>>(h, m, n);
+  }
+  
+  for(int n : {10000, 100000, 1000000}) {
+    setOpsTest<cs540::Map<int,int>>(h, m, n);
   }
   
   {
-    dispTestName("Find test", m);
-    findTest<cs540::Map<int,int>>();
-    dispTestName("Find test", w);
-    findTest<cs540::StdMapWrapper<int,int>>();
+    const std::string ms = demangle(typeid(cs540::Map<std::string,int>));
+    const std::string ws = demangle(typeid(cs540::StdMapWrapper<std::string,int>));
+    const std::string bs = demangle(typeid(cs540::BPlusMap<std::string,int>));
+    for(int n : {10000, 100000, 1000000}) {
+      stringFindTest<cs540::Map<std::string,int>>(h, ms, n);
+      stringFindTest<cs540::StdMapWrapper<std::string,int>>(h, ws, n);
+      stringFindTest<cs540::BPlusMap<std::string,int>>(h, bs, n);
+    }
   }
   
   /*
@@ -566,51 +620,86 @@ int main() {
     How do they perform relative to one another?
     How might this have affected other performance tests?
   */
-  {
-    dispTestName("Iteration test", m);
-    iterationTest<cs540::Map<int,int>>(10000);
-    iterationTest<cs540::Map<int,int>>(20000);
-    iterationTest<cs540::Map<int,int>>(40000);
-    iterationTest<cs540::Map<int,int>>(80000);
-    iterationTest<cs540::Map<int,int>>(160000);
-    iterationTest<cs540::Map<int,int>>(320000);
-    iterationTest<cs540::Map<int,int>>(640000);
-    iterationTest<cs540::Map<int,int>>(1280000);
-    iterationTest<cs540::Map<int,int>>(2560000);
-    iterationTest<cs540::Map<int,int>>(5120000);
-#if DO_BIG_ITERATION_TEST
-    //Optional test. This is more ram than the remote machines have and will likely take a long time to run.
-    iterationTest<cs540::Map<int,int>>(600000000);
-#endif
-    dispTestName("Iteration test", w);
-    iterationTest<cs540::StdMapWrapper<int,int>>(10000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(20000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(40000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(80000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(160000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(320000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(640000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(1280000);
-    iterationTest<cs540::StdMapWrapper<int,int>>(5120000);
+  for(int n = 10000; n <= 5120000; n *= 2) {
+    iterationTest<cs540::Map<int,int>>(h, m, n);
+    iterationTest<cs540::StdMapWrapper<int,int>>(h, w, n);
+    iterationTest<cs540::BPlusMap<int,int>>(h, b, n);
+  }
 #if DO_BIG_ITERATION_TEST
   //Optional test. This is more ram than the remote machines have and will likely take a long time to run.
-  iterationTest<cs540::Map<int,int>>(600000000);
+  iterationTest<cs540::Map<int,int>>(h, m, 600000000);
 #endif
+  
+  //Test copy constructor scaling
+  for(int n : sizes) {
+    if(n < 10000) continue;
+    copyTest<cs540::Map<int,int>>(h, m, n);
+    copyTest<cs540::StdMapWrapper<int,int>>(h, w, n);
+    copyTest<cs540::BPlusMap<int,int>>(h, b, n);
+  }
+  
+  for(int n : sizes) {
+    if(n < 10000) continue;
+    indexTest<cs540::Map<int,int>>(h, m, n);
+    // Linear for std::map, so not the biggest one
+    if(n < 10000000) {
+      indexTest<cs540::StdMapWrapper<int,int>>(h, w, n);
+    }
   }
   
+  // Skewed string keyed traffic with misses and writes mixed in: ours first,
+  // then YCSB's read mostly (B), read latest (D) and short scan (E) mixes
   {
-    //Test copy constructor scaling
-    dispTestName("Copy test", m);
-    copyTest<cs540::Map<int,int>>(10000);
-    copyTest<cs540::Map<int,int>>(100000);
-    copyTest<cs540::Map<int,int>>(1000000);
-    copyTest<cs540::Map<int,int>>(10000000);
-    dispTestName("Copy test", w);
-    copyTest<cs540::StdMapWrapper<int,int>>(10000);
-    copyTest<cs540::StdMapWrapper<int,int>>(100000);
-    copyTest<cs540::StdMapWrapper<int,int>>(1000000);
-    copyTest<cs540::StdMapWrapper<int,int>>(10000000);
+    std::vector<std::pair<std::string, cs540::workload::Spec>> workloads;
+    for(size_t n : {100000, 1000000}) {
+      cs540::workload::Spec spec;
+      spec.records = n;
+      spec.ops = 200000;
+      workloads.push_back(std::make_pair("workload zipf 30% miss", spec));
+      
+      cs540::workload::Spec b = spec;
+      b.distribution = cs540::workload::Distribution::UNIFORM;
+      b.hit_ratio = 1;
+      b.read = 95, b.insert = 5, b.erase = 0, b.scan = 0;
+      workloads.push_back(std::make_pair("workload ycsb-b uniform", b));
+      
+      cs540::workload::Spec d = b;
+      d.distribution = cs540::workload::Distribution::LATEST;
+      workloads.push_back(std::make_pair("workload ycsb-d latest", d));
+      
+      cs540::workload::Spec e = spec;
+      e.hit_ratio = 1;
+      e.read = 0, e.insert = 5, e.erase = 0, e.scan = 95;
+      e.ops = 20000;
+      workloads.push_back(std::make_pair("workload ycsb-e scan", e));
+    }
+    workloads.insert(workloads.end(), custom.begin(), custom.end());
+    
+    typedef cs540::Map<std::string,std::string> MapSS;
+    typedef cs540::StdMapWrapper<std::string,std::string> WrapperSS;
+    typedef cs540::BPlusMap<std::string,std::string> BPlusSS;
+    const std::string ms = demangle(typeid(MapSS));
+    const std::string ws = demangle(typeid(WrapperSS));
+    const std::string bs = demangle(typeid(BPlusSS));
+    for(auto &nw : workloads) {
+      if(!h.wanted(nw.first, nw.second.records)) {
+        continue;
+      }
+      cs540::workload::Workload wl(nw.second);
+      auto s1 = workloadTest<MapSS>(h, ms, nw.first, wl);
+      auto s2 = workloadTest<WrapperSS>(h, ws, nw.first, wl);
+      auto s3 = workloadTest<BPlusSS>(h, bs, nw.first, wl);
+      assert(s1.hits == s2.hits && s1.scanned == s2.scanned && s1.erases == s2.erases);
+      assert(s1.hits == s3.hits && s1.scanned == s3.scanned && s1.erases == s3.erases);
+      (void)s2;
+      (void)s3;
+      if(opts.format == cs540::bench::Format::TEXT && opts.out.empty()) {
+        std::cout << nw.first << " n=" << nw.second.records << ": " << s1.reads << " reads ("
+                  << s1.hits << " hit), " << s1.inserts << " inserts, " << s1.erases << " erases, "
+                  << s1.scans << " scans over " << s1.scanned << " elements\n";
+      }
+    }
   }
   
-  //Add your own indexibility scaling test here
+  h.report();
 }
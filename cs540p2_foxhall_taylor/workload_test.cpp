@@ -0,0 +1,148 @@
+// Compile with -std=c++11
+//
+// Checks that generated workloads look like what was asked for: the skew,
+// the hit ratio, the op mix and key sizes, and that a seed always gives the
+// same thing. Then replays one on Map and std::map and makes sure they agree.
+
+#include "Workload.hpp"
+#include "Map.hpp"
+#include <assert.h>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace cs540::workload;
+
+void test_zipf() {
+  ZipfGenerator zipf(1000, 0.99);
+  std::mt19937_64 engine(5);
+  std::vector<int> counts(1000);
+  const int draws = 200000;
+  for (int i = 0; i < draws; i++) {
+    uint64_t r = zipf(engine);
+    assert(r < 1000);
+    counts[r]++;
+  }
+  // Rank 0 is about 1/H(1000) ~ 13% of the draws and twice as likely as rank 1,
+  // the top ten get about 40% and the bottom half well under 10%
+  assert(counts[0] > draws / 10 && counts[0] < draws / 6);
+  assert(counts[0] > counts[1] * 3 / 2 && counts[1] > counts[10]);
+  int top = 0, bottom = 0;
+  for (int i = 0; i < 10; i++) {
+    top += counts[i];
+  }
+  for (int i = 500; i < 1000; i++) {
+    bottom += counts[i];
+  }
+  assert(top > draws / 3 && bottom < draws / 10);
+
+  bool threw = false;
+  try {
+    ZipfGenerator bad(10, 1.0);
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  assert(threw);
+}
+
+void test_generated() {
+  Spec spec = parse_spec("dist=zipf,hit=0.7,key=32,value=10,read=80,insert=10,erase=5,scan=5,records=5000,ops=50000");
+  assert(spec.key_size == 32 && spec.records == 5000 && spec.read == 80);
+  Workload w(spec);
+  assert(w.load_keys().size() == 5000 && w.ops().size() == 50000 && w.value().size() == 10);
+
+  std::set<std::string> loaded(w.load_keys().begin(), w.load_keys().end());
+  assert(loaded.size() == 5000);
+  size_t reads = 0, hits = 0, inserts = 0, erases = 0, scans = 0;
+  std::map<std::string, int> popularity;
+  for (const Operation& op: w.ops()) {
+    assert(op.key.size() == 32);
+    switch (op.type) {
+    case OpType::READ:
+      reads++;
+      if (loaded.count(op.key)) {
+        hits++;
+        popularity[op.key]++;
+      }
+      break;
+    case OpType::INSERT:
+      inserts++;
+      // New every time
+      assert(loaded.insert(op.key).second);
+      break;
+    case OpType::ERASE:
+      erases++;
+      break;
+    case OpType::SCAN:
+      scans++;
+      break;
+    }
+  }
+  double ops = w.ops().size();
+  assert(reads / ops > 0.78 && reads / ops < 0.82);
+  assert(inserts / ops > 0.09 && inserts / ops < 0.11);
+  assert(erases / ops > 0.04 && erases / ops < 0.06 && scans / ops > 0.04 && scans / ops < 0.06);
+  // Erases only ever take back what got inserted, so this is the real ratio
+  assert(double(hits) / reads > 0.68 && double(hits) / reads < 0.72);
+
+  // The hottest key is way past its fair share, 1/H(5000) ~ 11% of hits
+  int hottest = 0;
+  for (auto& kv: popularity) {
+    hottest = std::max(hottest, kv.second);
+  }
+  assert(hottest > int(hits / 20));
+
+  // Same seed, same workload, a different seed changes it
+  Workload again(spec);
+  assert(again.load_keys() == w.load_keys() && again.ops().back().key == w.ops().back().key);
+  spec.seed = 2;
+  Workload other(spec);
+  assert(other.load_keys() != w.load_keys());
+
+  // Keys can't go shorter than the unique part
+  assert(Workload::make_key(7, 4).size() == 20 && Workload::make_key(7, 4) != Workload::make_key(8, 4));
+
+  bool threw = false;
+  try {
+    parse_spec("dist=pareto");
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  assert(threw);
+}
+
+void test_replay() {
+  Spec spec;
+  spec.records = 3000;
+  spec.ops = 30000;
+  spec.erase = 10;
+  spec.scan_length = 20;
+  Workload w(spec);
+
+  cs540::Map<std::string, std::string> m;
+  std::map<std::string, std::string> mirror;
+  load(m, w);
+  load(mirror, w);
+  Stats s1 = run(m, w);
+  Stats s2 = run(mirror, w);
+  assert(s1.reads == s2.reads && s1.hits == s2.hits && s1.erases == s2.erases);
+  assert(s1.scanned == s2.scanned && s1.bytes == s2.bytes && s1.inserts == s2.inserts);
+  assert(m.size() == mirror.size());
+  auto it = m.begin();
+  for (auto& kv: mirror) {
+    assert(it->first == kv.first);
+    ++it;
+  }
+  // There's more erases than inserts here, so some loaded keys went too
+  assert(s1.erases > s1.inserts && m.size() < spec.records);
+}
+
+int main() {
+  test_zipf();
+  test_generated();
+  test_replay();
+  std::cout << "Workload checks passed" << std::endl;
+}